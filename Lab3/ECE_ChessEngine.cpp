@@ -16,6 +16,12 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <functional>
+#include "uciReader.h"
 
 /**
  * @brief Class for handling chess engine
@@ -27,16 +33,64 @@ private:
     int child_to_parent[2];
     pid_t pid;
 
+    std::thread reader;                     // drains the engine output so the render loop never blocks on it
+    std::mutex replyMutex;                  // guards the promise shared with the reader thread
+    std::promise<std::string> reply;        // fulfilled with the best move of the current search
+    bool awaitingReply;                     // is a search running whose best move is not delivered yet?
+    std::future<std::string> bestMove;      // polled by the render loop
+
+    /**
+     * @brief Reader thread: splits the engine output into lines and
+     *        hands the best move of each search to the waiting future
+     * 
+     */
+    void readOutput() {
+        uciLineReader lines;
+        std::string_view line;
+        uciMessage msg;
+
+        // readFrom() returns 0 once the engine has exited and the pipe is closed
+        // (a read interrupted by a signal is retried there, not taken for the end)
+        while (lines.readFrom(child_to_parent[0]) > 0) {
+            while (lines.nextLine(line)) {
+                if (parseUCILine(line, msg) && msg.type == UCI_BESTMOVE) {
+                    bool delivered = false;
+                    {
+                        std::lock_guard<std::mutex> lock(replyMutex);
+                        if (awaitingReply) {
+                            awaitingReply = false;
+                            reply.set_value(std::string(msg.bestMove));
+                            delivered = true;
+                        }
+                    }
+                    // Let the waiting render loop know (called on the reader thread)
+                    if (delivered && onReply) {
+                        onReply();
+                    }
+                }
+            }
+        }
+    }
+
 public:
+    std::function<void()> onReply;          // optional, called on the reader thread when a best move arrives
+
     // Initialize pipes
     ECE_ChessEngine() {
         pipe(parent_to_child);
         pipe(child_to_parent);
+        awaitingReply = false;
     }
 
     // Destructor
     ~ECE_ChessEngine() {
+        // Ask the engine to quit, it closes its end of the pipe and the reader thread returns
+        std::string command = "quit\n";
+        write(parent_to_child[1], command.c_str(), command.size());
         close(parent_to_child[1]);
+        if (reader.joinable()) {
+            reader.join();
+        }
         close(child_to_parent[0]);
 
         // Wait for the child process to finish
@@ -95,21 +149,32 @@ public:
                 std::cerr << "Error writing to pipe" << std::endl;
                 return false;
             }
+            reader = std::thread(&ECE_ChessEngine::readOutput, this);
             std::cout << "Komodo Chess Engine Initialized.\n";
         }
         return true;
     }
 
     /**
-     * @brief Send the user's move to the Komodo engine
+     * @brief Send the current position to the Komodo engine and start the search
+     *        (a FEN keeps the command the same size however long the game gets)
+     *        Returns at once, poll getResponseMove for the reply
      * 
-     * @param moveHistory 
+     * @param fen 
      * @return bool status 
      */
-    bool sendMove(std::string moveHistory) {
+    bool sendMove(std::string fen) {
         if (pid != 0)
         {
-            std::string command = "position startpos moves " + moveHistory + "\n";
+            // Fresh promise for this search
+            {
+                std::lock_guard<std::mutex> lock(replyMutex);
+                reply = std::promise<std::string>();
+                bestMove = reply.get_future();
+                awaitingReply = true;
+            }
+
+            std::string command = "position fen " + fen + "\n";
             if (write(parent_to_child[1], command.c_str(), command.size()) == -1) {
                 std::cerr << "Error writing to pipe" << std::endl;
                 return false;
@@ -126,37 +191,26 @@ public:
 
     /**
      * @brief Get the Response Move from the Komodo Engine
+     *        Non-blocking: call once per frame until it returns true
      * 
      * @param strMove 
-     * @return bool status 
+     * @return bool status (false while the engine is still searching)
      */
     bool getResponseMove(std::string& strMove) {
-        if (pid != 0)
-        {
-            char buffer[256];
-            int bytesRead;
-            std::string komodoOutput;
-
-            while ((bytesRead = read(child_to_parent[0], buffer, sizeof(buffer) - 1)) > 0) {
-                if (bytesRead >= sizeof(buffer)) {
-                    std::cerr << "Buffer overflow detected." << std::endl;
-                    return false;
-                }
-                buffer[bytesRead] = '\0';
-                komodoOutput += buffer;
-
-                std::size_t found = komodoOutput.find("bestmove");
-                std::string word, move;
-                if (found != std::string::npos) {
-                    std::istringstream iss(komodoOutput.substr(found));
-                    iss >> word; 
-                    iss >> move; 
-                    std::cout << "Komodo Move: " << move << std::endl;
-                    strMove = move; // Return the best move found
-                    return true;
-                }
-            }
+        if (!bestMove.valid() || bestMove.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
             return false;
         }
+        strMove = bestMove.get();
+        std::cout << "Komodo Move: " << strMove << std::endl;
+        return true;
+    }
+
+    /**
+     * @brief Is a search running whose best move has not been collected yet?
+     * 
+     * @return bool 
+     */
+    bool isThinking() const {
+        return bestMove.valid();
     }
 };
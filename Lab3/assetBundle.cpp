@@ -0,0 +1,308 @@
+/**
+ * @file assetBundle.cpp
+ * @brief Baked asset bundle: memory mapped reader and the helpers shared with the baker
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "assetBundle.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <regex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Largest texture side accepted (keeps the level sizes far from overflowing)
+static const uint32_t MAX_TEXTURE_SIZE = 1u << 15;
+
+
+/**
+ * @brief Pack the mesh properties, one bit per boolean
+ *
+ * @param meshProps
+ * @return uint32_t
+ */
+uint32_t packMeshProps(const meshPropsT& meshProps)
+{
+    return (meshProps.hasBones ? MESH_PROP_BONES : 0) | (meshProps.hasFaces ? MESH_PROP_FACES : 0) |
+           (meshProps.hasNormals ? MESH_PROP_NORMALS : 0) | (meshProps.hasPositions ? MESH_PROP_POSITIONS : 0) |
+           (meshProps.hasTangentsAndBitangents ? MESH_PROP_TANGENTS : 0) |
+           (meshProps.hasTextureCoords ? MESH_PROP_TEXTURE_COORDS : 0) |
+           (meshProps.hasVertexColors ? MESH_PROP_VERTEX_COLORS : 0);
+}
+
+/**
+ * @brief Mesh properties from their packed bits
+ *
+ * @param propFlags
+ * @param numOfUVChannels
+ * @return meshPropsT
+ */
+meshPropsT unpackMeshProps(uint32_t propFlags, uint32_t numOfUVChannels)
+{
+    meshPropsT meshProps = {(propFlags & MESH_PROP_BONES) != 0, (propFlags & MESH_PROP_FACES) != 0,
+                            (propFlags & MESH_PROP_NORMALS) != 0, (propFlags & MESH_PROP_POSITIONS) != 0,
+                            (propFlags & MESH_PROP_TANGENTS) != 0, (propFlags & MESH_PROP_TEXTURE_COORDS) != 0,
+                            (propFlags & MESH_PROP_VERTEX_COLORS) != 0, numOfUVChannels};
+    return meshProps;
+}
+
+/**
+ * @brief Scan the index blob of a mesh, an index past the vertices would make the
+ *        draw call fetch outside the vertex buffer
+ *
+ * @param indices
+ * @param indexCount
+ * @param vertexCount
+ * @return true if every index is below vertexCount
+ */
+bool indicesInRange(const unsigned short* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+    unsigned short largest = 0;
+    for (uint32_t i = 0; i < indexCount; i++)
+        largest = std::max(largest, indices[i]);
+    return indexCount == 0 || largest < vertexCount;
+}
+
+/**
+ * @brief The MTL files name .jpg textures in the model directory; the .bmp of
+ *        the same name is loaded from the board or the pieces directory
+ *
+ * @param mtlTexture
+ * @param path
+ * @return true if the name was understood
+ */
+bool textureFilePath(const std::string& mtlTexture, std::string& path)
+{
+    // Matching pattern and rule creation
+    // Any combination of 0-9, space in the beginning or end is allowed!
+    // Compiled once, matching with it is safe from the loader threads
+    static const std::regex regexRule("\\s*([\\w0-9]+)\\.\\s*");
+    std::smatch matches;
+    if (!std::regex_search(mtlTexture, matches, regexRule))
+    {
+        path = mtlTexture;
+        return false;
+    }
+
+    path = matches[1].str();
+    // Process directory path, it's a short cut for now!
+    if (path == "12951_Stone_Chess_Board_diff")
+    { // Chess board directory path
+        path = "Lab3/Stone_Chess_Board/" + path;
+    }
+    else
+    { // Chess pieces directory path
+        path = "Lab3/Chess/" + path;
+    }
+    // Add the bmp extension
+    path += ".bmp";
+    return true;
+}
+
+/**
+ * @brief A string field of a record ends within the field
+ *
+ * @param field
+ * @param size
+ * @return true if terminated
+ */
+static bool terminated(const char* field, size_t size)
+{
+    return memchr(field, 0, size) != nullptr;
+}
+
+/**
+ * @brief Bytes [offset, offset + length) are in the file, after the records, 4-byte aligned
+ *
+ * @param offset
+ * @param length
+ * @param dataStart
+ * @param fileSize
+ * @return true if the range is valid
+ */
+static bool validRange(uint64_t offset, uint64_t length, uint64_t dataStart, uint64_t fileSize)
+{
+    return offset % 4 == 0 && offset >= dataStart && offset <= fileSize && length <= fileSize - offset;
+}
+
+/**
+ * @brief Map the bundle and check the header, every record and every mesh index
+ *
+ * @param path
+ * @return true if the bundle can be used
+ */
+bool assetBundle::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(bundleHeaderT))
+    {
+        fprintf(stderr, "Asset bundle %s is truncated\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = (size_t)st.st_size;
+    void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    mapping = data;
+    mappingSize = fileSize;
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    header = (const bundleHeaderT*)bytes;
+    if (memcmp(header->magic, ASSET_BUNDLE_MAGIC, sizeof(ASSET_BUNDLE_MAGIC)) != 0 ||
+        header->version != ASSET_BUNDLE_VERSION || header->vertexSize != sizeof(vertexT))
+    {
+        fprintf(stderr, "Asset bundle %s has an old format, bake it again\n", path.c_str());
+        close();
+        return false;
+    }
+
+    uint64_t meshStart = sizeof(bundleHeaderT);
+    uint64_t textureStart = meshStart + (uint64_t)header->meshCount * sizeof(bundleMeshT);
+    uint64_t dataStart = textureStart + (uint64_t)header->textureCount * sizeof(bundleTextureT);
+    if (dataStart > fileSize)
+    {
+        fprintf(stderr, "Asset bundle %s is truncated\n", path.c_str());
+        close();
+        return false;
+    }
+    meshRecords = (const bundleMeshT*)(bytes + meshStart);
+    textureRecords = (const bundleTextureT*)(bytes + textureStart);
+
+    for (uint32_t m = 0; m < header->meshCount; m++)
+    {
+        const bundleMeshT& record = meshRecords[m];
+        bool valid = terminated(record.source, sizeof(record.source)) &&
+                     terminated(record.name, sizeof(record.name)) &&
+                     terminated(record.texture, sizeof(record.texture)) &&
+                     record.indexCount % 3 == 0 &&
+                     validRange(record.vertexOffset, (uint64_t)record.vertexCount * sizeof(vertexT), dataStart, fileSize) &&
+                     validRange(record.indexOffset, (uint64_t)record.indexCount * sizeof(unsigned short), dataStart, fileSize) &&
+                     indicesInRange((const unsigned short*)(bytes + record.indexOffset), record.indexCount, record.vertexCount);
+        if (!valid)
+        {
+            fprintf(stderr, "Asset bundle %s is damaged (mesh %u)\n", path.c_str(), m);
+            close();
+            return false;
+        }
+    }
+
+    for (uint32_t t = 0; t < header->textureCount; t++)
+    {
+        const bundleTextureT& record = textureRecords[t];
+        bool valid = terminated(record.path, sizeof(record.path)) &&
+                     record.width > 0 && record.height > 0 &&
+                     record.width <= MAX_TEXTURE_SIZE && record.height <= MAX_TEXTURE_SIZE &&
+                     record.levelCount > 0 && record.levelCount <= (uint32_t)BUNDLE_MAX_LEVELS;
+        for (uint32_t level = 0; valid && level < record.levelCount; level++)
+        {
+            uint64_t levelBytes = (uint64_t)mipSize(record.width, level) * mipSize(record.height, level) * 3;
+            valid = validRange(record.levelOffset[level], levelBytes, dataStart, fileSize);
+        }
+        if (!valid)
+        {
+            fprintf(stderr, "Asset bundle %s is damaged (texture %u)\n", path.c_str(), t);
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Unmap the bundle; the pointers it gave are no longer valid
+ *
+ */
+void assetBundle::close()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    meshRecords = nullptr;
+    textureRecords = nullptr;
+}
+
+/**
+ * @brief Interleaved vertices of a mesh
+ *
+ * @param record
+ * @return const vertexT*
+ */
+const vertexT* assetBundle::meshVertices(const bundleMeshT& record) const
+{
+    return (const vertexT*)((const unsigned char*)mapping + record.vertexOffset);
+}
+
+/**
+ * @brief Face indices of a mesh
+ *
+ * @param record
+ * @return const unsigned short*
+ */
+const unsigned short* assetBundle::meshIndices(const bundleMeshT& record) const
+{
+    return (const unsigned short*)((const unsigned char*)mapping + record.indexOffset);
+}
+
+/**
+ * @brief Number of meshes baked from an OBJ file
+ *
+ * @param source
+ * @return size_t
+ */
+size_t assetBundle::countMeshes(const std::string& source) const
+{
+    size_t count = 0;
+    for (size_t m = 0; m < meshCount(); m++)
+    {
+        if (source == meshRecords[m].source)
+            count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Texture baked from a file
+ *
+ * @param path
+ * @return const bundleTextureT*
+ */
+const bundleTextureT* assetBundle::findTexture(const std::string& path) const
+{
+    for (size_t t = 0; t < textureCount(); t++)
+    {
+        if (path == textureRecords[t].path)
+            return &textureRecords[t];
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Texels of a mip level
+ *
+ * @param record
+ * @param level
+ * @return const unsigned char*
+ */
+const unsigned char* assetBundle::textureLevel(const bundleTextureT& record, uint32_t level) const
+{
+    return (const unsigned char*)mapping + record.levelOffset[level];
+}
@@ -0,0 +1,142 @@
+/*
+Objective:
+Baked asset bundle: the meshes of the OBJ files (interleaved, with their bounds
+and geometric centers) and their textures with every mip level, made offline by
+chess_asset_bake and memory mapped at startup instead of running Assimp and the
+BMP loader. No OpenGL here, the baker uses it too.
+*/
+
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "chessCommon.h"
+
+// First bytes of a bundle, written by the baker and checked by open()
+const char ASSET_BUNDLE_MAGIC[4] = {'C', 'H', 'A', 'B'};
+// Bump when the layout below or vertexT changes
+const uint32_t ASSET_BUNDLE_VERSION = 1;
+// Bundle baked by the build, in the working directory
+const char* const ASSET_BUNDLE_PATH = "assets.bundle";
+// Mip levels of a texture, enough for 32768 texels
+const int BUNDLE_MAX_LEVELS = 16;
+
+// meshPropsT booleans packed one bit each (mesh cache and bundle records)
+enum {
+    MESH_PROP_BONES = 1 << 0,
+    MESH_PROP_FACES = 1 << 1,
+    MESH_PROP_NORMALS = 1 << 2,
+    MESH_PROP_POSITIONS = 1 << 3,
+    MESH_PROP_TANGENTS = 1 << 4,
+    MESH_PROP_TEXTURE_COORDS = 1 << 5,
+    MESH_PROP_VERTEX_COLORS = 1 << 6
+};
+
+uint32_t packMeshProps(const meshPropsT& meshProps);
+meshPropsT unpackMeshProps(uint32_t propFlags, uint32_t numOfUVChannels);
+// Every index of a stored mesh refers to one of its vertices (checked once when a file is opened)
+bool indicesInRange(const unsigned short* indices, uint32_t indexCount, uint32_t vertexCount);
+
+/**
+ * @brief Start of a bundle, followed by the mesh records, the texture records and the data
+ *
+ */
+typedef struct
+{
+    char magic[4];              // "CHAB"
+    uint32_t version;           // ASSET_BUNDLE_VERSION
+    uint32_t vertexSize;        // sizeof(vertexT) of the baker
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t reserved;
+} bundleHeaderT;
+
+/**
+ * @brief One component of an OBJ file. Vertices (vertexT) and indices (unsigned short)
+ *        are at the offsets given.
+ *
+ */
+typedef struct
+{
+    char source[128];           // OBJ file, as in objFiles
+    char name[64];              // node name
+    char texture[128];          // diffuse texture as written in the MTL file
+    uint32_t propFlags;         // MESH_PROP_ bits
+    uint32_t numOfUVChannels;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint64_t vertexOffset;      // from the start of the bundle
+    uint64_t indexOffset;
+    float center[3];            // geometric center (average of the vertices)
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t reserved;
+} bundleMeshT;
+
+/**
+ * @brief One texture with its mip chain. Each level is BGR, 3 bytes per texel,
+ *        rows bottom up (as in the BMP file) without padding.
+ *
+ */
+typedef struct
+{
+    char path[128];             // as given by textureFilePath
+    uint32_t width;             // level 0
+    uint32_t height;
+    uint32_t levelCount;        // down to 1x1
+    uint32_t reserved;
+    uint64_t levelOffset[BUNDLE_MAX_LEVELS];
+} bundleTextureT;
+
+// Size of a mip level
+inline uint32_t mipSize(uint32_t size, uint32_t level) { return (size >> level) > 0 ? (size >> level) : 1; }
+
+// File loaded for a texture named in an MTL file (the MTL names .jpg files, only the .bmp files are shipped)
+// Returns false when the name cannot be understood (path is then the name as it is)
+bool textureFilePath(const std::string& mtlTexture, std::string& path);
+
+/**
+ * @class assetBundle
+ * @brief Read-only mapping of a bundle. open() checks every record against the
+ *        file size and every mesh index against its vertex count, so the pointers
+ *        returned after that are safe to read and to draw.
+ *
+ */
+class assetBundle {
+private:
+    void* mapping;
+    size_t mappingSize;
+    const bundleHeaderT* header;
+    const bundleMeshT* meshRecords;
+    const bundleTextureT* textureRecords;
+
+public:
+    assetBundle() : mapping(nullptr), mappingSize(0), header(nullptr), meshRecords(nullptr), textureRecords(nullptr) {}
+    ~assetBundle() { close(); }
+    assetBundle(const assetBundle&) = delete;
+    assetBundle& operator=(const assetBundle&) = delete;
+
+    // Map and check a bundle; false (with a message unless it does not exist) when it cannot be used
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return mapping != nullptr; }
+
+    size_t meshCount() const { return header ? header->meshCount : 0; }
+    const bundleMeshT& mesh(size_t i) const { return meshRecords[i]; }
+    const vertexT* meshVertices(const bundleMeshT& record) const;
+    const unsigned short* meshIndices(const bundleMeshT& record) const;
+    // Meshes of one OBJ file
+    size_t countMeshes(const std::string& source) const;
+
+    size_t textureCount() const { return header ? header->textureCount : 0; }
+    const bundleTextureT& texture(size_t i) const { return textureRecords[i]; }
+    // nullptr when the texture was not baked
+    const bundleTextureT* findTexture(const std::string& path) const;
+    const unsigned char* textureLevel(const bundleTextureT& record, uint32_t level) const;
+
+    size_t size() const { return mappingSize; }
+};
+
+#endif
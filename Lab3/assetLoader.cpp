@@ -0,0 +1,264 @@
+/**
+ * @file assetLoader.cpp
+ * @brief Worker pool reading the OBJ files and the BMP textures in parallel
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstring>
+#include <vector>
+#include <glm/glm.hpp>
+#include "assetLoader.h"
+#include <common/objloader.hpp>
+
+
+/**
+ * @brief Components of an OBJ file: from the asset bundle when it was baked,
+ *        otherwise from its mesh cache when it is up to date, otherwise imported
+ *        with Assimp (when built with it) and written to the cache for the next launch
+ *
+ * @param path          OBJ file
+ * @param components    the components are appended
+ * @param bundle        baked assets, keep it open until setupGLBuffers
+ * @param cache         mapping of the cache, keep it until setupGLBuffers
+ * @return true if the components were loaded
+ */
+bool loadMeshes(const char* path, std::vector<chessComponent>& components, const assetBundle& bundle, meshCache& cache)
+{
+    if (bundle.countMeshes(path) > 0)
+    {
+        for (size_t m = 0; m < bundle.meshCount(); m++)
+        {
+            const bundleMeshT& record = bundle.mesh(m);
+            if (strcmp(record.source, path) != 0)
+            {
+                continue;
+            }
+            components.emplace_back();
+            chessComponent& component = components.back();
+            component.storeMeshProps(unpackMeshProps(record.propFlags, record.numOfUVChannels));
+            component.storeComponentID(record.name);
+            if (record.texture[0] != '\0')
+            {
+                component.storeTextureID(record.texture);
+            }
+            component.attachPackedMesh(bundle.meshVertices(record), record.vertexCount, bundle.meshIndices(record), record.indexCount);
+            component.storeBounds(glm::vec3(record.center[0], record.center[1], record.center[2]),
+                                  glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]),
+                                  glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]));
+        }
+        return true;
+    }
+
+    if (cache.load(path, components))
+    {
+        return true;
+    }
+
+#ifdef USE_LAB3_ASSIMP
+    size_t first = components.size();
+    if (!loadAssImpLab3(path, components))
+    {
+        return false;
+    }
+    // A cache that cannot be written only costs the import again next time
+    if (meshCache::write(path, components, first))
+    {
+        std::cout << "Wrote mesh cache " << meshCache::cachePath(path) << std::endl;
+    }
+    return true;
+#else
+    std::cout << path << " is not in " << ASSET_BUNDLE_PATH << " and this build has no Assimp, run chess_asset_bake" << std::endl;
+    return false;
+#endif
+}
+
+/**
+ * @brief Start the worker threads (they wait for start())
+ *
+ * @param bundle
+ * @param caches
+ * @param threads
+ */
+assetLoader::assetLoader(const assetBundle& bundle, meshCache* caches, unsigned int threads)
+    : bundle(bundle), caches(caches), unfinished(0), submitted(0), completed(0), stopping(false)
+{
+    if (threads == 0)
+        threads = 1;
+    for (unsigned int t = 0; t < threads; t++)
+        workers.emplace_back(&assetLoader::workerLoop, this);
+}
+
+/**
+ * @brief Stop the workers once their current job is over
+ *
+ */
+assetLoader::~assetLoader()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        jobs.clear();
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    // Results nobody took
+    for (loadResultT& result : results)
+    {
+        if (result.type == LOADED_TEXTURE && result.ok)
+            unmapBMP(result.bmp);
+    }
+}
+
+/**
+ * @brief Run jobs until the pool stops
+ *
+ */
+void assetLoader::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            jobReady.wait(guard, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+/**
+ * @brief Queue a job
+ *
+ * @param job
+ */
+void assetLoader::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(std::move(job));
+        unfinished++;
+        submitted++;
+    }
+    jobReady.notify_one();
+}
+
+/**
+ * @brief Hand a result to the GL thread; the job that made it is finished
+ *
+ * @param result
+ */
+void assetLoader::complete(loadResultT& result)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        results.push_back(std::move(result));
+        unfinished--;
+        completed++;
+    }
+    resultReady.notify_one();
+}
+
+/**
+ * @brief Job: the components of an OBJ file, then a job for each texture they need
+ *
+ * @param file
+ */
+void assetLoader::loadOBJ(int file)
+{
+    loadResultT result;
+    result.type = LOADED_MESHES;
+    result.file = file;
+    result.ok = loadMeshes(objFiles[file], result.components, bundle, caches[file]);
+
+    // Baked textures are uploaded straight from the bundle, the others are read here
+    for (const chessComponent& component : result.components)
+    {
+        const std::string& path = component.texturePath();
+        if (path.empty() || bundle.findTexture(path) != nullptr)
+            continue;
+        bool firstRequest;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            firstRequest = requestedTextures.insert(path).second;
+        }
+        if (firstRequest)
+            submit([this, path]() { loadTexture(path); });
+    }
+    // Queued after the texture jobs, so the pool never looks finished in between
+    complete(result);
+}
+
+/**
+ * @brief Job: map a BMP file and check it, its pages are read ahead for the upload
+ *
+ * @param path
+ */
+void assetLoader::loadTexture(const std::string& path)
+{
+    loadResultT result;
+    result.type = LOADED_TEXTURE;
+    result.file = -1;
+    result.path = path;
+    result.ok = mapBMP(path.c_str(), result.bmp);
+    complete(result);
+}
+
+/**
+ * @brief Queue the OBJ files
+ *
+ */
+void assetLoader::start()
+{
+    for (int f = 0; f < NUM_OBJ_FILES; f++)
+        submit([this, f]() { loadOBJ(f); });
+}
+
+/**
+ * @brief Take the oldest result
+ *
+ * @param result
+ * @param timeoutSeconds
+ * @return false if none came in time
+ */
+bool assetLoader::next(loadResultT& result, double timeoutSeconds)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (!resultReady.wait_for(guard, std::chrono::duration<double>(timeoutSeconds), [this]() { return !results.empty(); }))
+        return false;
+    result = std::move(results.front());
+    results.pop_front();
+    return true;
+}
+
+/**
+ * @brief Every job finished and every result taken
+ *
+ * @return true if loading is over
+ */
+bool assetLoader::done()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return unfinished == 0 && results.empty();
+}
+
+/**
+ * @brief Jobs completed out of jobs known so far (texture jobs appear as the OBJ files are read)
+ *
+ * @param completedJobs
+ * @param submittedJobs
+ */
+void assetLoader::progress(int& completedJobs, int& submittedJobs)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    completedJobs = completed;
+    submittedJobs = submitted;
+}
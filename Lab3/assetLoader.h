@@ -0,0 +1,102 @@
+/*
+Objective:
+Parallel asset loading: the OBJ files and the BMP textures are read on a pool
+of worker threads and handed back through a queue to the GL thread, which only
+uploads them
+*/
+
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chessComponent.h"
+#include "assetBundle.h"
+#include "meshCache.h"
+
+// Most loader threads (there are only a few large assets)
+const unsigned int MAX_LOADER_THREADS = 8;
+
+/**
+ * @brief What a finished job produced
+ *
+ */
+typedef enum loadResultType {
+    LOADED_MESHES,      // the components of an OBJ file
+    LOADED_TEXTURE      // a BMP file, mapped
+} loadResultType;
+
+/**
+ * @brief A finished job, ready for the upload
+ *
+ */
+typedef struct
+{
+    loadResultType type;
+    bool ok;
+    int file;                                   // LOADED_MESHES: index in objFiles
+    std::vector<chessComponent> components;     // LOADED_MESHES: not uploaded yet
+    std::string path;                           // LOADED_TEXTURE: BMP file
+    bmpMappingT bmp;                            // LOADED_TEXTURE: unmapBMP after the upload
+} loadResultT;
+
+// OBJ file components from the asset bundle, the mesh cache, or Assimp (then cached)
+bool loadMeshes(const char* path, std::vector<chessComponent>& components, const assetBundle& bundle, meshCache& cache);
+
+/**
+ * @class assetLoader
+ * @brief Worker pool loading the scene. start() queues one job per OBJ file; each
+ *        of them queues a job per texture its components use (unless the texture
+ *        is in the bundle). The GL thread takes the results with next() until done().
+ *        No GL call is made on the workers.
+ *
+ */
+class assetLoader {
+private:
+    const assetBundle& bundle;
+    meshCache* caches;                      // one per OBJ file, mapped until the upload
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable jobReady;       // a job was queued, or the pool is stopping
+    std::condition_variable resultReady;    // a result was queued
+    std::deque<std::function<void()>> jobs;
+    std::deque<loadResultT> results;
+    std::set<std::string> requestedTextures;
+    int unfinished;                         // jobs queued or running
+    int submitted;
+    int completed;
+    bool stopping;
+
+    void workerLoop();
+    // Queue a job (any thread)
+    void submit(std::function<void()> job);
+    // Queue the result of the job running on this worker, which is then finished
+    void complete(loadResultT& result);
+    void loadOBJ(int file);
+    void loadTexture(const std::string& path);
+
+public:
+    // caches: NUM_OBJ_FILES mesh caches, keep them until the meshes are uploaded
+    assetLoader(const assetBundle& bundle, meshCache* caches, unsigned int threads);
+    // Waits for the running jobs, the queued ones are dropped
+    ~assetLoader();
+    assetLoader(const assetLoader&) = delete;
+    assetLoader& operator=(const assetLoader&) = delete;
+
+    void start();
+    // GL thread: take the oldest result, waiting up to timeoutSeconds for one
+    bool next(loadResultT& result, double timeoutSeconds);
+    // Every job finished and every result taken
+    bool done();
+    // Progress: jobs completed out of jobs known so far
+    void progress(int& completedJobs, int& submittedJobs);
+};
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * @file bench_bmp_load.cpp
+ * @brief Benchmark of the BMP texture loading on the 12 wood textures of the
+ *        pieces: loadBMP_custom (fread into a heap copy) against the mapped
+ *        loader (mmap, header checked against the file size, rows used in place).
+ *        The reading is timed on the CPU; the upload too when a headless EGL
+ *        context can be made, and the two textures are compared.
+ *        The files are read from the page cache after the first round.
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <GL/glew.h>
+#include <common/texture.hpp>
+#include "Lab3/chessHeadless.h"
+
+// Passes over the 12 files per variant
+const int ROUNDS = 20;
+
+// The "Reading image" line of readBMP_custom is not part of the measurement
+static int quietStdout()
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    return saved;
+}
+
+static void restoreStdout(int saved)
+{
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+/**
+ * @brief Sum of the pixel bytes of every row, what an upload reads
+ *
+ * @param rows
+ * @param rowStride
+ * @param width
+ * @param height
+ * @return unsigned long
+ */
+static unsigned long sumPixels(const unsigned char* rows, size_t rowStride, unsigned int width, unsigned int height)
+{
+    unsigned long sum = 0;
+    for (unsigned int row = 0; row < height; row++)
+    {
+        const unsigned char* pixel = rows + row * rowStride;
+        for (unsigned int b = 0; b < width * 3; b++)
+            sum += pixel[b];
+    }
+    return sum;
+}
+
+/**
+ * @brief Time ROUNDS passes over the files
+ *
+ * @param name
+ * @param bytes     bytes of pixels read per pass
+ * @param quiet     the pass prints (readBMP_custom), hide it
+ * @param pass      returns false on a failed file
+ * @return true if every pass succeeded
+ */
+template <typename F>
+static bool timeRounds(const char* name, size_t bytes, bool quiet, F pass)
+{
+    int saved = quiet ? quietStdout() : -1;
+    bool ok = true;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < ROUNDS && ok; r++)
+        ok = pass();
+    auto end = std::chrono::high_resolution_clock::now();
+    if (quiet)
+        restoreStdout(saved);
+    if (!ok)
+    {
+        fprintf(stderr, "%s failed\n", name);
+        return false;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count() / ROUNDS;
+    printf("%-28s %8.2f ms/pass %8.0f MB/s\n", name, ms, bytes / (1024.0 * 1024.0) / (ms / 1000.0));
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    // The viewer runs from Lab3/, the textures are in Lab3/Chess
+    std::string dir = "Lab3/Chess";
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--dir") && i + 1 < argc)
+            dir = argv[++i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [--dir <directory of the wood BMP files>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::string> files;
+    for (const char* shade : {"woodlight", "wooddark"})
+        for (int n = 0; n < 6; n++)
+            files.push_back(dir + "/" + shade + std::to_string(n) + ".bmp");
+
+    // Check the files once, and the two loaders agree on them
+    size_t pixelBytes = 0;
+    size_t heapBytes = 0;
+    for (const std::string& file : files)
+    {
+        bmpMappingT bmp;
+        if (!mapBMP(file.c_str(), bmp))
+            return EXIT_FAILURE;
+        int saved = quietStdout();
+        bmpImageT image;
+        bool read = readBMP_custom(file.c_str(), image);
+        restoreStdout(saved);
+        if (!read || image.width != bmp.width || image.height != bmp.height ||
+            sumPixels(&image.data[0], bmp.rowStride, image.width, image.height) != sumPixels(bmp.pixels, bmp.rowStride, bmp.width, bmp.height))
+        {
+            fprintf(stderr, "%s: the loaders disagree\n", file.c_str());
+            return EXIT_FAILURE;
+        }
+        pixelBytes += (size_t)bmp.rowStride * bmp.height;
+        heapBytes += image.data.size();
+        unmapBMP(bmp);
+    }
+    printf("%zu files, %.1f MB of pixels, %.1f MB copied to the heap per pass by readBMP_custom\n",
+           files.size(), pixelBytes / (1024.0 * 1024.0), heapBytes / (1024.0 * 1024.0));
+
+    // Reading: every pixel byte is touched, as the upload would
+    volatile unsigned long sink = 0;
+    bool ok = timeRounds("read: fread + heap copy", pixelBytes, true, [&]() {
+        for (const std::string& file : files)
+        {
+            bmpImageT image;
+            if (!readBMP_custom(file.c_str(), image))
+                return false;
+            sink = sink + sumPixels(&image.data[0], (image.width * 3 + 3) & ~3u, image.width, image.height);
+        }
+        return true;
+    });
+    ok = ok && timeRounds("read: mmap, rows in place", pixelBytes, false, [&]() {
+        for (const std::string& file : files)
+        {
+            bmpMappingT bmp;
+            if (!mapBMP(file.c_str(), bmp))
+                return false;
+            sink = sink + sumPixels(bmp.pixels, bmp.rowStride, bmp.width, bmp.height);
+            unmapBMP(bmp);
+        }
+        return true;
+    });
+    if (!ok)
+        return EXIT_FAILURE;
+
+    // Upload: needs a GL context, the surfaceless one of the headless mode
+    headlessContextT offscreen = {};
+    if (!createHeadlessContext(offscreen))
+    {
+        printf("No headless GL context, the upload is not timed\n");
+        return 0;
+    }
+    glewExperimental = true;
+    // GLEW looks for a GLX display the surfaceless context does not have: check the entry points the uploads use
+    if (glewInit() != GLEW_OK && (glGenerateMipmap == NULL || glGenBuffers == NULL))
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        destroyHeadlessContext(offscreen);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<GLuint> textures(files.size());
+    auto upload = [&](GLuint (*load)(const char*)) {
+        for (size_t f = 0; f < files.size(); f++)
+            if ((textures[f] = load(files[f].c_str())) == 0)
+                return false;
+        // The copies are over once the driver is done with the texture
+        glFinish();
+        glDeleteTextures((GLsizei)textures.size(), &textures[0]);
+        return true;
+    };
+    ok = timeRounds("upload: loadBMP_custom", pixelBytes, true, [&]() { return upload(loadBMP_custom); });
+    ok = ok && timeRounds("upload: loadBMP_mapped", pixelBytes, false, [&]() { return upload(loadBMP_mapped); });
+
+    // Same texels either way
+    for (size_t f = 0; ok && f < files.size(); f++)
+    {
+        int saved = quietStdout();
+        GLuint copied = loadBMP_custom(files[f].c_str());
+        restoreStdout(saved);
+        GLuint mapped = loadBMP_mapped(files[f].c_str());
+        std::vector<unsigned char> texels[2];
+        GLuint both[2] = {copied, mapped};
+        for (int t = 0; t < 2; t++)
+        {
+            GLint width, height;
+            glBindTexture(GL_TEXTURE_2D, both[t]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+            texels[t].resize((size_t)width * height * 3);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_BGR, GL_UNSIGNED_BYTE, &texels[t][0]);
+        }
+        glDeleteTextures(2, both);
+        if (texels[0] != texels[1])
+        {
+            fprintf(stderr, "%s: the textures differ\n", files[f].c_str());
+            ok = false;
+        }
+    }
+    destroyHeadlessContext(offscreen);
+    return ok ? 0 : EXIT_FAILURE;
+}
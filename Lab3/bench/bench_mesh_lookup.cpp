@@ -0,0 +1,155 @@
+/**
+ * @file bench_mesh_lookup.cpp
+ * @brief Microbenchmark of the per-frame mesh lookup in the render loop:
+ *        find_if over the components comparing names returned by value,
+ *        against the mesh handle table resolved once at load time.
+ *        Runs on the CPU only (no window or GL context), the draw calls
+ *        themselves are not part of the measurement.
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Lab3/chessCommon.h"
+
+// Frames timed per variant
+const int FRAMES = 200000;
+
+// Heap allocations made by the process, to show the per-frame cost of the string copies
+static std::atomic<long> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* p = malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+/**
+ * @brief Stand-in for chessComponent: a name and something to "draw"
+ *
+ */
+class fakeComponent {
+private:
+    std::string cName;
+
+public:
+    int drawCount = 0;
+    explicit fakeComponent(const std::string& name) : cName(name) {}
+    // The old accessor, a copy of the name per call
+    std::string getComponentIDByValue() { return cName; }
+    const std::string& getComponentID() const { return cName; }
+};
+
+/**
+ * @brief Time FRAMES passes of a per-frame loop
+ *
+ * @param name
+ * @param frame
+ */
+template <typename F>
+static void timeFrames(const char* name, F frame)
+{
+    long allocationsBefore = allocations;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < FRAMES; i++)
+        frame();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / FRAMES;
+    printf("%-22s %10.1f ns/frame %8.1f allocations/frame\n", name, ns, double(allocations - allocationsBefore) / FRAMES);
+}
+
+int main()
+{
+    // Components in load order: the board, the pieces and the other objects of the chess OBJ file
+    std::vector<fakeComponent> components;
+    components.emplace_back(meshNames[MESH_BOARD]);
+    for (int i = 0; i < 8; i++)
+        components.emplace_back("Scene_object_with_a_long_name_" + std::to_string(i));
+    for (int m = MESH_WHITE_PAWN; m < NUM_MESHES; m++)
+        components.emplace_back(meshNames[m]);
+
+    // The start position: board plus 32 pieces, each entry holding its name and its handle
+    typedef struct
+    {
+        bool isAlive;
+        std::string meshName;
+        meshID mesh;
+    } entry;
+    std::unordered_map<int, entry> modelMap;
+    modelMap[EMPTY] = {true, meshNames[MESH_BOARD], MESH_BOARD};
+    const meshID startMeshes[16] = {MESH_WHITE_PAWN, MESH_WHITE_PAWN, MESH_WHITE_PAWN, MESH_WHITE_PAWN,
+                                    MESH_WHITE_PAWN, MESH_WHITE_PAWN, MESH_WHITE_PAWN, MESH_WHITE_PAWN,
+                                    MESH_WHITE_ROOK, MESH_WHITE_ROOK, MESH_WHITE_KNIGHT, MESH_WHITE_KNIGHT,
+                                    MESH_WHITE_BISHOP, MESH_WHITE_BISHOP, MESH_WHITE_QUEEN, MESH_WHITE_KING};
+    for (int p = WHITE_PAWN_1; p < EMPTY; p++)
+    {
+        meshID mesh = (meshID)(startMeshes[p % 16] + (p >= BLACK_PAWN_1 ? MESH_BLACK_PAWN - MESH_WHITE_PAWN : 0));
+        modelMap[p] = {true, meshNames[mesh], mesh};
+    }
+
+    // Resolved once, as at load time in the viewer
+    fakeComponent* meshTable[NUM_MESHES] = {};
+    for (auto& component : components)
+        for (int m = 0; m < NUM_MESHES; m++)
+            if (component.getComponentID() == meshNames[m])
+                meshTable[m] = &component;
+
+    timeFrames("find_if by name", [&]() {
+        for (auto& mapEntry : modelMap)
+        {
+            entry& e = mapEntry.second;
+            if (!e.isAlive)
+                continue;
+            auto cit = std::find_if(components.begin(), components.end(), [&](auto& component) { return component.getComponentIDByValue() == e.meshName; });
+            if (cit != components.end())
+                cit->drawCount++;
+        }
+    });
+
+    // Start the second variant from zero, keeping the counts of the first to compare
+    std::vector<int> drawCounts;
+    for (auto& component : components)
+    {
+        drawCounts.push_back(component.drawCount);
+        component.drawCount = 0;
+    }
+
+    timeFrames("mesh handle table", [&]() {
+        for (auto& mapEntry : modelMap)
+        {
+            entry& e = mapEntry.second;
+            if (!e.isAlive)
+                continue;
+            fakeComponent* component = meshTable[e.mesh];
+            if (component != nullptr)
+                component->drawCount++;
+        }
+    });
+
+    // Both variants must have drawn every mesh the same number of times
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        if (components[i].drawCount != drawCounts[i])
+        {
+            fprintf(stderr, "Draw count mismatch for %s\n", components[i].getComponentID().c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file bench_sliders.cpp
+ * @brief Microbenchmark of the sliding piece attack lookups:
+ *        magic (or PEXT) tables against the ray walk they are built from
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "Lab3/chessPosition.h"
+
+// Number of (square, occupancy) samples and passes over them
+const int SAMPLES = 1 << 16;
+const int PASSES = 200;
+
+/**
+ * @brief Time PASSES sweeps of an attack function over the samples
+ *
+ * @param name
+ * @param attacks
+ * @param squares
+ * @param occupancies
+ * @return bitboard checksum (keeps the compiler from dropping the loop)
+ */
+template <typename F>
+static bitboard timeAttacks(const char* name, F attacks, const std::vector<int>& squares, const std::vector<bitboard>& occupancies)
+{
+    bitboard checksum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            checksum += attacks(squares[i], occupancies[i]);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / (double(PASSES) * SAMPLES);
+    printf("%-24s %8.2f ns/lookup\n", name, ns);
+    return checksum;
+}
+
+int main()
+{
+    // Time the one time table initialization
+    auto start = std::chrono::high_resolution_clock::now();
+    initBitboards();
+    auto end = std::chrono::high_resolution_clock::now();
+#ifdef CHESS_USE_PEXT
+    printf("Table initialization (PEXT): %.2f ms\n", std::chrono::duration<double, std::milli>(end - start).count());
+#else
+    printf("Table initialization (magic): %.2f ms\n", std::chrono::duration<double, std::milli>(end - start).count());
+#endif
+
+    // Random squares and board-like occupancies (about a quarter of the squares filled)
+    std::vector<int> squares(SAMPLES);
+    std::vector<bitboard> occupancies(SAMPLES);
+    srand(2024);
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        bitboard occ = 0;
+        for (int n = 0; n < 16; n++)
+            occ |= squareBB(rand() % NUM_SQUARES);
+        squares[i] = rand() % NUM_SQUARES;
+        occupancies[i] = occ;
+    }
+
+    // Both implementations must agree before timing them
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        if (rookAttacks(squares[i], occupancies[i]) != rookAttacksRay(squares[i], occupancies[i]) ||
+            bishopAttacks(squares[i], occupancies[i]) != bishopAttacksRay(squares[i], occupancies[i]))
+        {
+            printf("Mismatch on square %d\n", squares[i]);
+            return 1;
+        }
+    }
+
+    bitboard checksum = 0;
+    checksum += timeAttacks("rook (ray walk)", rookAttacksRay, squares, occupancies);
+    checksum += timeAttacks("rook (table)", rookAttacks, squares, occupancies);
+    checksum += timeAttacks("bishop (ray walk)", bishopAttacksRay, squares, occupancies);
+    checksum += timeAttacks("bishop (table)", bishopAttacks, squares, occupancies);
+    checksum += timeAttacks("queen (ray walk)", [](int sq, bitboard occ) { return rookAttacksRay(sq, occ) | bishopAttacksRay(sq, occ); }, squares, occupancies);
+    checksum += timeAttacks("queen (table)", queenAttacks, squares, occupancies);
+
+    printf("checksum %016llx\n", (unsigned long long)checksum);
+    return 0;
+}
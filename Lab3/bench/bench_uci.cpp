@@ -0,0 +1,140 @@
+/**
+ * @file bench_uci.cpp
+ * @brief Microbenchmark of the engine output parsing: the ring buffer line
+ *        reader against appending every read to a string and searching it
+ *        for "bestmove" (the old getResponseMove loop)
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "Lab3/uciReader.h"
+
+// Size of one pipe read, as in the old reader loop
+const size_t CHUNK = 256;
+
+/**
+ * @brief Synthetic engine output: "info" lines of a growing search and a final bestmove
+ *
+ * @param bytes     approximate size of the output
+ * @return std::string
+ */
+static std::string makeOutput(size_t bytes)
+{
+    std::string out;
+    char line[256];
+    for (int n = 0; out.size() < bytes; n++)
+    {
+        snprintf(line, sizeof(line),
+                 "info depth %d seldepth %d multipv 1 score cp %d nodes %d nps %d hashfull %d tbhits 0 time %d pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6\n",
+                 n % 40 + 1, n % 40 + 8, (n * 37) % 200 - 100, n * 1500, 2000000 + n, n % 1000, n);
+        out += line;
+    }
+    out += "bestmove e2e4 ponder e7e5\n";
+    return out;
+}
+
+/**
+ * @brief Feed the output through the ring buffer reader in pipe sized chunks
+ *
+ * @param output
+ * @param infoLines     number of info lines parsed
+ * @return std::string  the best move
+ */
+static std::string ringReader(const std::string& output, long& infoLines)
+{
+    uciLineReader lines;
+    std::string_view line;
+    uciMessage msg;
+    std::string bestMove;
+    uint64_t nodes = 0;
+
+    for (size_t offset = 0; offset < output.size();)
+    {
+        offset += lines.feed(output.data() + offset, std::min(CHUNK, output.size() - offset));
+        while (lines.nextLine(line))
+        {
+            if (!parseUCILine(line, msg))
+                continue;
+            if (msg.type == UCI_INFO)
+            {
+                infoLines++;
+                nodes += msg.info.nodes;
+            }
+            else if (msg.type == UCI_BESTMOVE)
+            {
+                bestMove = std::string(msg.bestMove);
+            }
+        }
+    }
+    return nodes ? bestMove : std::string();
+}
+
+/**
+ * @brief The old reader: append each chunk and search the whole string for "bestmove"
+ *
+ * @param output
+ * @return std::string  the best move
+ */
+static std::string appendAndFind(const std::string& output)
+{
+    std::string accumulated;
+    for (size_t offset = 0; offset < output.size(); offset += CHUNK)
+    {
+        accumulated.append(output, offset, CHUNK);
+        size_t found = accumulated.find("bestmove");
+        if (found != std::string::npos)
+            return accumulated.substr(found + 9, 4);
+    }
+    return std::string();
+}
+
+/**
+ * @brief Time one reader over the output
+ *
+ * @param name
+ * @param output
+ * @param reader
+ */
+template <typename F>
+static void timeReader(const char* name, const std::string& output, F reader)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string move = reader(output);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double mb = output.size() / (1024.0 * 1024.0);
+    if (move != "e2e4")
+    {
+        fprintf(stderr, "%s: wrong best move \"%s\"\n", name, move.c_str());
+        exit(EXIT_FAILURE);
+    }
+    printf("%-18s %6.1f MB %9.2f ms %9.1f MB/s\n", name, mb, seconds * 1000.0, mb / seconds);
+}
+
+int main(int argc, char* argv[])
+{
+    // Size of the large run in MB (the old reader only gets the small runs, it is quadratic)
+    size_t megaBytes = (argc > 1) ? (size_t)atol(argv[1]) : 64;
+
+    for (size_t mb : {1, 2})
+    {
+        std::string output = makeOutput(mb * 1024 * 1024);
+        timeReader("append + find", output, appendAndFind);
+        timeReader("ring buffer", output, [](const std::string& out) { long n = 0; return ringReader(out, n); });
+    }
+
+    std::string output = makeOutput(megaBytes * 1024 * 1024);
+    long infoLines = 0;
+    timeReader("ring buffer", output, [&](const std::string& out) { return ringReader(out, infoLines); });
+    printf("Info lines parsed: %ld\n", infoLines);
+    return 0;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file chessAnimation.cpp
+ * @brief Pool of piece tweens advanced with a fixed timestep
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "chessAnimation.h"
+#include <algorithm>
+#include <cmath>
+
+
+/**
+ * @brief Position along the path for a progress in [0,1]
+ *
+ * @param curve
+ * @param t
+ * @return float
+ */
+static float ease(easing curve, float t)
+{
+    switch (curve)
+    {
+    case EASE_IN_OUT:
+        return t * t * (3.f - 2.f * t);
+    case EASE_IN:
+        return t * t;
+    default:
+        return t;
+    }
+}
+
+/**
+ * @brief Construct a new tween pool, all slots free
+ *
+ */
+tweenPool::tweenPool() : activeTweens(0), accumulator(0.0), speed(1.f), duration(2.f)
+{
+    for (tweenT& tween : tweens)
+        tween.active = false;
+}
+
+/**
+ * @brief Write the tween's current position into its piece
+ *
+ * @param tween
+ * @param modelMap
+ */
+void tweenPool::apply(const tweenT& tween, tModelMap& modelMap) const
+{
+    float t = (tween.duration > 0.f) ? std::min(1.f, tween.elapsed / tween.duration) : 1.f;
+    tPosition& cTPosition = modelMap[tween.target];
+    cTPosition.tPos = tween.startPos + ease(tween.curve, t) * (tween.endPos - tween.startPos);
+    // The jump follows half a sine wave over the whole move
+    cTPosition.tPos.z += tween.arcHeight * sinf(t * 3.14159265f);
+    cTPosition.modelValid = false;
+}
+
+/**
+ * @brief Put the piece at its destination and free the slot
+ *
+ * @param tween
+ * @param modelMap
+ */
+void tweenPool::finish(tweenT& tween, tModelMap& modelMap)
+{
+    tPosition& cTPosition = modelMap[tween.target];
+    cTPosition.tPos = tween.endPos;
+    cTPosition.modelValid = false;
+    if (tween.hideAtEnd)
+        cTPosition.isAlive = false;
+    tween.active = false;
+    activeTweens--;
+}
+
+/**
+ * @brief Animate a piece from one point to another
+ *
+ * @param modelMap
+ * @param target
+ * @param from
+ * @param to
+ * @param curve
+ * @param arcHeight     peak height above the straight path
+ * @param hideAtEnd     remove the piece from the board when it arrives
+ */
+void tweenPool::start(tModelMap& modelMap, piece target, const glm::vec3& from, const glm::vec3& to,
+                      easing curve, float arcHeight, bool hideAtEnd)
+{
+    // A piece follows one path at a time: reuse its slot, or take a free one
+    tweenT* slot = nullptr;
+    for (tweenT& tween : tweens)
+    {
+        if (tween.active && tween.target == target)
+        {
+            slot = &tween;
+            break;
+        }
+        if (!tween.active && slot == nullptr)
+            slot = &tween;
+    }
+
+    tweenT tween = {target, from, to, arcHeight, 0.f, duration, curve, hideAtEnd, true};
+    if (slot == nullptr)
+    {
+        // Pool full: this one lands at once
+        tween.elapsed = tween.duration;
+        apply(tween, modelMap);
+        if (hideAtEnd)
+            modelMap[target].isAlive = false;
+        return;
+    }
+    if (!slot->active)
+        activeTweens++;
+    *slot = tween;
+    apply(*slot, modelMap);
+}
+
+/**
+ * @brief Advance the animations by one frame of wall time, in fixed steps of animation time
+ *
+ * @param frameSeconds
+ * @param modelMap
+ */
+void tweenPool::update(double frameSeconds, tModelMap& modelMap)
+{
+    if (activeTweens == 0)
+    {
+        // Time spent with nothing to animate is not carried over
+        accumulator = 0.0;
+        return;
+    }
+
+    accumulator += std::min(frameSeconds, MAX_FRAME_SECONDS) * speed;
+    double steps = std::floor(accumulator / STEP_SECONDS);
+    if (steps < 1.0)
+        return;
+    // The tweens are closed form, so all the steps of a frame are taken at once
+    accumulator -= steps * STEP_SECONDS;
+    float advance = (float)(steps * STEP_SECONDS);
+
+    for (tweenT& tween : tweens)
+    {
+        if (!tween.active)
+            continue;
+        tween.elapsed += advance;
+        if (tween.elapsed >= tween.duration)
+            finish(tween, modelMap);
+        else
+            apply(tween, modelMap);
+    }
+}
+
+/**
+ * @brief Put every piece at the end of its animation
+ *
+ * @param modelMap
+ */
+void tweenPool::finishAll(tModelMap& modelMap)
+{
+    for (tweenT& tween : tweens)
+    {
+        if (tween.active)
+            finish(tween, modelMap);
+    }
+    accumulator = 0.0;
+}
+
+/**
+ * @brief Drop the animations without moving the pieces
+ *
+ */
+void tweenPool::clear()
+{
+    for (tweenT& tween : tweens)
+        tween.active = false;
+    activeTweens = 0;
+    accumulator = 0.0;
+}
+
+/**
+ * @brief Set the speed factor (animation seconds per wall second)
+ *
+ * @param factor
+ */
+void tweenPool::setSpeed(float factor)
+{
+    speed = std::max(MIN_SPEED, std::min(MAX_SPEED, factor));
+}
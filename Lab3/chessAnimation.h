@@ -0,0 +1,101 @@
+/*
+Objective:
+Piece animations: a pool of position tweens with easing curves, advanced
+with a fixed timestep so they play the same at any frame rate
+*/
+
+#ifndef CHESS_ANIMATION_H
+#define CHESS_ANIMATION_H
+
+#include "chessCommon.h"
+
+/**
+ * @brief Easing curves (progress in [0,1] to position in [0,1])
+ *
+ */
+typedef enum easing {
+    EASE_LINEAR,
+    EASE_IN_OUT,        // smoothstep: starts and lands gently
+    EASE_IN             // accelerates (a captured piece sinking)
+} easing;
+
+/**
+ * @brief One piece moving from one point to another
+ *
+ */
+typedef struct
+{
+    piece target;
+    glm::vec3 startPos;
+    glm::vec3 endPos;
+    float arcHeight;    // peak height above the straight path (knights jump)
+    float elapsed;      // animation seconds played
+    float duration;     // animation seconds in total
+    easing curve;
+    bool hideAtEnd;     // the piece is removed from the board when it arrives
+    bool active;
+} tweenT;
+
+/**
+ * @class tweenPool
+ * @brief Fixed size pool of tweens. Time is consumed in fixed steps of animation
+ *        time (frame time times the speed factor), so the pieces are at the same
+ *        place after the same wall time whatever the frame rate. Several pieces
+ *        can move at once; a piece that is given a new tween drops its old one.
+ *
+ */
+class tweenPool {
+private:
+    static const int MAX_TWEENS = 64;
+    tweenT tweens[MAX_TWEENS];
+    int activeTweens;
+    double accumulator;         // animation time not consumed by a step yet
+    float speed;                // animation seconds per wall second
+
+    // Write the tween's current position into its piece
+    void apply(const tweenT& tween, tModelMap& modelMap) const;
+    void finish(tweenT& tween, tModelMap& modelMap);
+
+public:
+    // Fixed step of animation time
+    static constexpr double STEP_SECONDS = 1.0 / 120.0;
+    // Longest frame time taken into account (after a stall the animation slows instead of jumping)
+    static constexpr double MAX_FRAME_SECONDS = 0.1;
+    // Speed factor limits (replays run compressed up to MAX_SPEED)
+    static constexpr float MIN_SPEED = 0.1f;
+    static constexpr float MAX_SPEED = 100.0f;
+
+    // Length of a move at speed 1 (seconds)
+    float duration;
+
+    tweenPool();
+
+    // Animate a piece, it is put at 'from' right away
+    void start(tModelMap& modelMap, piece target, const glm::vec3& from, const glm::vec3& to,
+               easing curve, float arcHeight = 0.f, bool hideAtEnd = false);
+    // Advance the animations by one frame of wall time
+    void update(double frameSeconds, tModelMap& modelMap);
+    // Skip: put every piece at the end of its animation
+    void finishAll(tModelMap& modelMap);
+    // Drop the animations without touching the pieces (the board is rebuilt)
+    void clear();
+
+    // Speed factor, clamped to [MIN_SPEED, MAX_SPEED]
+    void setSpeed(float factor);
+    float getSpeed() const { return speed; }
+
+    bool busy() const { return activeTweens > 0; }
+    int count() const { return activeTweens; }
+};
+
+
+/**
+ * @brief Structure to track rendering and animation
+ *
+ */
+typedef struct {
+    tModelMap cTModelMap;       // Piece-wise rendering information
+    tweenPool animations;       // Pieces moving
+} chessModel;
+
+#endif
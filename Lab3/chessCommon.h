@@ -52,6 +52,35 @@ typedef enum piece {
 } piece;
 
 
+/**
+ * @brief Enum for the meshes drawn on the board, dense handles into the mesh table
+ *        (resolved from the component names once after loading)
+ * 
+ */
+typedef enum meshID {
+    MESH_BOARD,
+    MESH_WHITE_PAWN, MESH_WHITE_KNIGHT, MESH_WHITE_BISHOP, MESH_WHITE_ROOK, MESH_WHITE_QUEEN, MESH_WHITE_KING,
+    MESH_BLACK_PAWN, MESH_BLACK_KNIGHT, MESH_BLACK_BISHOP, MESH_BLACK_ROOK, MESH_BLACK_QUEEN, MESH_BLACK_KING,
+
+    // Number of meshes
+    NUM_MESHES
+} meshID;
+
+// Component name of each mesh in the OBJ files
+const char* const meshNames[NUM_MESHES] = {
+    "12951_Stone_Chess_Board",
+    "PEDONE13", "Object3", "ALFIERE3", "TORRE3", "REGINA2", "RE2",
+    "PEDONE12", "Object02", "ALFIERE02", "TORRE02", "REGINA01", "RE01"
+};
+
+// OBJ files of the scene, relative to the working directory
+const int NUM_OBJ_FILES = 2;
+const char* const objFiles[NUM_OBJ_FILES] = {
+    "Lab3/Stone_Chess_Board/12951_Stone_Chess_Board_v1_L3.obj",
+    "Lab3/Chess/chess-mod.obj"
+};
+
+
 /**
  * @brief Structure to hold each target piece
  * 
@@ -63,8 +92,13 @@ typedef struct
     glm::vec3 cScale;     // Scale of the piece
     glm::vec3 tPos;       // Postion
     bool isAlive;         // If the piece is alive
-    std::string meshName; // Mesh name
+    meshID mesh;          // Mesh handle
     int user;             // white=0, black=1
+    // Cached by chessComponent::genModelMatrix, cleared whenever tPos or mesh change
+    bool modelValid;      // model and bounds below are up to date
+    glm::mat4 model;      // Model matrix
+    glm::vec3 boundsCenter;   // World space bounding box
+    glm::vec3 boundsExtent;
 } tPosition;
 
 
@@ -77,21 +111,38 @@ const float CHESS_BOX_SIZE = (float)(CBSCALE * 5.4);
 const float CPSCALE = 0.015f;
 // Platform height
 const float PHEIGHT = -3.0f;
-// Hash to hold the target Model matrix spec for each Chess component
-typedef std::unordered_map <piece, tPosition> tModelMap;
+// Peak height of a knight's jump above the board
+const float KNIGHT_JUMP = 8.0f;
+// How far a captured piece sinks into the board before it is removed
+const float SINK_DEPTH = 5.0f;
 
+// One vertex of the interleaved vertex buffer (also the layout of the mesh cache and the asset bundle)
+typedef struct
+{
+    glm::vec3 position;
+    glm::vec2 uv;
+    glm::vec3 normal;
+} vertexT;
 
 /**
- * @brief Structure to track rendering and animation
+ * @brief Per-frame shader data, laid out as the std140 "FrameData" uniform block
+ *        of the shaders (binding point FRAME_DATA_BINDING)
  * 
  */
-typedef struct {
-    tModelMap cTModelMap;                                                       // Piece-wise rendering information
-    bool isPieceMoving;                                                         // If animation is on
-    piece pieceMoving;                                                          // The piece that is moving
-    glm::vec3 startPos;                                                         // Starting pos of animation
-    glm::vec3 endPos;                                                           // Ending pos of animation
-    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;      // Starting time of animation
-}chessModel;
+typedef struct
+{
+    glm::mat4 V;                            // offset 0
+    glm::mat4 P;                            // offset 64
+    glm::mat4 VP;                           // offset 128
+    glm::vec3 LightPosition_worldspace;     // offset 192
+    float LightPower;                       // offset 204
+    int lightSwitch;                        // offset 208 (bool in the shader)
+    int padding[3];                         // block size is a multiple of 16
+} frameDataT;
+static_assert(sizeof(frameDataT) == 224, "frameDataT must match the std140 FrameData block");
+const unsigned int FRAME_DATA_BINDING = 0;
+
+// Hash to hold the target Model matrix spec for each Chess component
+typedef std::unordered_map <piece, tPosition> tModelMap;
 
 #endif
@@ -4,28 +4,33 @@ Objective:
 Chess component class definition file
 */
 
+#include <cmath>
+#include <cstddef>
 #include "chessComponent.h"
+#include "assetBundle.h"
+#include "textureCache.h"
 
 
 // Compute the Geometric center
-// Inputs: None
+// Inputs: Interleaved vertices
 // Output: None
-void chessComponent::getGeometricCenter()
+void chessComponent::getGeometricCenter(const vertexT* vertexData, size_t vertexCount)
 {
     // Reset the geometric center
     cGeometricCener = glm::vec3(0.0f);
     
     //Sum all vertices
-    for (const auto& vertex : vertices)
+    for (size_t i = 0; i < vertexCount; i++)
     {
+        const glm::vec3& vertex = vertexData[i].position;
         cGeometricCener.x += vertex.x;
         cGeometricCener.y += vertex.y;
         cGeometricCener.z += vertex.z;
     }
     // Compute Average
-    if (vertices.size() > 0)
+    if (vertexCount > 0)
     { // Divide-by-zero protection
-        cGeometricCener = cGeometricCener / static_cast<float> (vertices.size());
+        cGeometricCener = cGeometricCener / static_cast<float> (vertexCount);
     }
     else
     { // No Vertices (Weird case)
@@ -34,20 +39,25 @@ void chessComponent::getGeometricCenter()
 }
 
 // Compute the Bounding box
-// Inputs: None
+// Inputs: Interleaved vertices
 // Output: None
-void chessComponent::getBoundingBox()
+void chessComponent::getBoundingBox(const vertexT* vertexData, size_t vertexCount)
 {
+    if (vertexCount == 0)
+    { // No Vertices (Weird case)
+        cBoundingLimitsMin = cBoundingLimitsMax = glm::vec3(0.0f);
+        return;
+    }
     // Initialize the min and max
-    cBoundingLimitsMin = vertices.front();
-    cBoundingLimitsMax = vertices.front();
+    cBoundingLimitsMin = vertexData[0].position;
+    cBoundingLimitsMax = vertexData[0].position;
 
     // Finding min and max iterating over
     // all vertices
-    for (const auto& vertex : vertices)
+    for (size_t i = 0; i < vertexCount; i++)
     {
-        cBoundingLimitsMin = glm::min(cBoundingLimitsMin, vertex);
-        cBoundingLimitsMax = glm::max(cBoundingLimitsMax, vertex);
+        cBoundingLimitsMin = glm::min(cBoundingLimitsMin, vertexData[i].position);
+        cBoundingLimitsMax = glm::max(cBoundingLimitsMax, vertexData[i].position);
     }
 }
 
@@ -71,19 +81,27 @@ chessComponent::chessComponent()
     normals.clear();
 
     // OpenGL Buffers management
+    vertexArray = 0;
     vertexbuffer = 0;
-    uvbuffer = 0;
-    normalbuffer = 0;
     elementbuffer = 0;
+    instancebuffer = 0;
+    instanceCapacity = 0;
+    indexCount = 0;
+    packedVertices = nullptr;
+    packedVertexCount = 0;
+    packedIndices = nullptr;
+    packedIndexCount = 0;
 
     // Component ID
     cName = "";
     cTextureFile = "";
+    cTexturePath = "";
 
     // Reset the geometric center
     cGeometricCener = glm::vec3(0.0f);
     cBoundingLimitsMin = glm::vec3(0.0f);
     cBoundingLimitsMin = glm::vec3(0.0f);
+    cBoundsKnown = false;
 
     // Reset the Texture handle
     Texture = 0;
@@ -150,40 +168,166 @@ void chessComponent::addFaceIndices(unsigned int *objFaceIndice)
     indices.push_back(objFaceIndice[2]);
 }
 
+// Use an interleaved mesh instead of the add functions above (mesh cache)
+// Inputs: Vertices and face indices, they must stay valid until setupGLBuffers
+// Output: None
+void chessComponent::attachPackedMesh(const vertexT* vertexData, size_t vertexCount, const unsigned short* indexData, size_t indexCount)
+{
+    packedVertices = vertexData;
+    packedVertexCount = vertexCount;
+    packedIndices = indexData;
+    packedIndexCount = indexCount;
+}
+
+// Interleave position, UV and normal of each vertex
+// Inputs: None
+// Output: Interleaved vertices
+void chessComponent::packVertices(std::vector<vertexT>& packed) const
+{
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        packed[i].position = vertices[i];
+        packed[i].uv = (i < uvs.size()) ? uvs[i] : glm::vec2(0.f);
+        packed[i].normal = (i < normals.size()) ? normals[i] : glm::vec3(0.f);
+    }
+}
+
+// Store the geometric center and bounding box computed offline
+// Inputs: Center, box min and max corners
+// Output: None
+void chessComponent::storeBounds(const glm::vec3& center, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    cGeometricCener = center;
+    cBoundingLimitsMin = boundsMin;
+    cBoundingLimitsMax = boundsMax;
+    cBoundsKnown = true;
+}
+
 // Setup rendering buffers
 // Inputs: None
 // Output: None
 void chessComponent::setupGLBuffers()
 {
+    // A cached mesh is uploaded as it is, an imported one is interleaved first
+    std::vector<vertexT> interleaved;
+    const vertexT* vertexData = packedVertices;
+    size_t vertexCount = packedVertexCount;
+    const unsigned short* indexData = packedIndices;
+    size_t indexTotal = packedIndexCount;
+    if (vertexData == nullptr)
+    {
+        packVertices(interleaved);
+        vertexData = interleaved.data();
+        vertexCount = interleaved.size();
+        indexData = indices.data();
+        indexTotal = indices.size();
+    }
+    indexCount = (GLsizei)indexTotal;
+
+    // The VAO records the whole vertex layout once, drawing only binds it
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+
     // Load it into a VBO
     glGenBuffers(1, &vertexbuffer);
     glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-    
-    // Load it into UV Buffer
-    glGenBuffers(1, &uvbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
-    
-    // Load it into the normals buffer
-    glGenBuffers(1, &normalbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(vertexT), vertexData, GL_STATIC_DRAW);
 
-    // Generate a buffer for the indices as well
+    // 1rst attribute : vertices
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(
+        0,                                          // attribute
+        3,                                          // size
+        GL_FLOAT,                                   // type
+        GL_FALSE,                                   // normalized?
+        sizeof(vertexT),                            // stride
+        (void*)offsetof(vertexT, position)          // array buffer offset
+    );
+
+    // 2nd attribute : UVs
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(
+        1,                                          // attribute
+        2,                                          // size
+        GL_FLOAT,                                   // type
+        GL_FALSE,                                   // normalized?
+        sizeof(vertexT),                            // stride
+        (void*)offsetof(vertexT, uv)                // array buffer offset
+    );
+
+    // 3rd attribute : normals
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2,                                          // attribute
+        3,                                          // size
+        GL_FLOAT,                                   // type
+        GL_FALSE,                                   // normalized?
+        sizeof(vertexT),                            // stride
+        (void*)offsetof(vertexT, normal)            // array buffer offset
+    );
+
+    // Generate a buffer for the indices as well (bound to the VAO)
     glGenBuffers(1, &elementbuffer);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexTotal * sizeof(unsigned short), indexData, GL_STATIC_DRAW);
 
-    // Compute the Geometric center
-    getGeometricCenter();
+    // Per instance model matrices, refilled every frame (room for the 16 pieces of a colour to start with)
+    instanceCapacity = 16;
+    instanceMatrices.reserve(instanceCapacity);
+    glGenBuffers(1, &instancebuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instancebuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
 
+    // 4th to 7th attributes : model matrix columns, advancing once per instance
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribPointer(
+            3 + column,                                 // attribute
+            4,                                          // size
+            GL_FLOAT,                                   // type
+            GL_FALSE,                                   // normalized?
+            sizeof(glm::mat4),                          // stride
+            (void*)(column * sizeof(glm::vec4))         // array buffer offset
+        );
+        glVertexAttribDivisor(3 + column, 1);
+    }
+
+    // Done recording, keep later buffer binds out of this VAO
+    glBindVertexArray(0);
+
+    if (!cBoundsKnown)
+    {
+        // Compute the Geometric center
+        getGeometricCenter(vertexData, vertexCount);
+        // Compute the Bounding box (for frustum culling)
+        getBoundingBox(vertexData, vertexCount);
+    }
+    // The cached data is not needed any more (its mapping can go)
+    packedVertices = nullptr;
+    packedIndices = nullptr;
+
+    // The parts of the model matrix that only depend on the mesh
+    // We want the board surface to be in the X/Z plane. Need to move in -y direction
+    // equal to board's height.
+    if (cIsBoard)
+    { // For Chess board eliminate the height by pushing it down by the height
+        // Apply the adjustment (Z is compensated to push the board down by depth)
+        cMeshOffset = glm::translate(glm::mat4(1.0f), {-cGeometricCener.x, -cGeometricCener.y, -cGeometricCener.z/2});
+    }
+    else
+    { // For all others get to X/Z plane with Y=0
+        cMeshOffset = glm::translate(glm::mat4(1.0f), {-cGeometricCener.x, 0.f, -cGeometricCener.z});
+    }
+    // Rotate Knight/Bishop by another 180 degree aroudn Z
+    cMeshTurn = cTurnAround ? glm::rotate(glm::mat4(1.0f), glm::radians(180.f), {0, 0, 1}) : glm::mat4(1.0f);
 }
 
 // Setup Texture buffers
 // Inputs: None
 // Output: None
-void chessComponent::setupTexture(GLuint& TextureID)
+void chessComponent::setupTexture(GLuint TextureID)
 {
     // Bind our texture in Texture Unit 0
     glActiveTexture(GL_TEXTURE0);
@@ -192,103 +336,96 @@ void chessComponent::setupTexture(GLuint& TextureID)
     glUniform1i(TextureID, 0);
 }
 
-// Setup rendering buffers
-// Inputs: None
+// Setup Texture buffers: the texture of the file is shared when another component loaded it
+// Inputs: Texture cache (must outlive the component), baked assets to take the texture from
+//         (nullptr or texture not baked: BMP file)
 // Output: None
-void chessComponent::setupTextureBuffers()
+void chessComponent::setupTextureBuffers(textureCache& textures, const assetBundle* bundle)
 {
-    // Matching pattern and rule creation
-    // Any combination of 0-9, space in the beginning or end is allowed!
-    // Discarded while converting to integer
-    std::string regexPattern = "\\s*([\\w0-9]+)\\.\\s*";  // Pattern       
-    std::regex  regexRule(regexPattern);                  // Create a custom search rule
-    // Match string
-    std::smatch matches;
-
-    // Perform search on the Texture file name search
-    if (std::regex_search(cTextureFile, matches, regexRule))
+    if (cTexturePath.empty())
     {
-        // Update the Texture file name (since we only support bmps)
-        cTextureFile = matches[1].str();
-        // Process directory path, it's a short cut for now!
-        if (cTextureFile == "12951_Stone_Chess_Board_diff")
-        { // Chess board directory path
-            cTextureFile = "Lab3/Stone_Chess_Board/" + cTextureFile;
+        std::cout << "Texture file not found for chess compoent!" << cName << std::endl;
+        return;
+    }
+
+    // Loaded already (by the parallel loader or for another component)
+    Texture = textures.acquire(cTexturePath);
+    if (Texture == 0)
+    {
+        // Load the texture, with its mip levels already made when it was baked
+        const bundleTextureT* baked = (bundle != nullptr) ? bundle->findTexture(cTexturePath) : nullptr;
+        if (baked != nullptr)
+        {
+            const unsigned char* levels[BUNDLE_MAX_LEVELS];
+            for (uint32_t level = 0; level < baked->levelCount; level++)
+            {
+                levels[level] = bundle->textureLevel(*baked, level);
+            }
+            textures.add(cTexturePath, loadBGRMipmaps(baked->width, baked->height, baked->levelCount, levels),
+                         baked->width, baked->height, baked->levelCount);
         }
         else
-        { // Chess pieces directory path
-            cTextureFile = "Lab3/Chess/" + cTextureFile;
+        {
+            bmpMappingT bmp;
+            if (mapBMP(cTexturePath.c_str(), bmp))
+            {
+                textures.add(cTexturePath, uploadMappedBMP(bmp), bmp.width, bmp.height,
+                             textureCache::fullMipLevels(bmp.width, bmp.height));
+                unmapBMP(bmp);
+            }
         }
-        // Add the bmp extension
-        cTextureFile += ".bmp";
-        // Test print
-        // std::cout << "Texture file is " << cTextureFile << std::endl;
+        Texture = textures.acquire(cTexturePath);
     }
-    else
-    {
-        std::cout << "Texture file not found for chess compoent!" << cName << std::endl;
-    }
-
-    // Load the texture
-    Texture = loadBMP_custom(&cTextureFile[0]);
+    cTextures = (Texture != 0) ? &textures : nullptr;
 }
 
-// Render a mesh
+// Forget the instances queued for the last frame
 // Inputs: None
 // Output: None
-void chessComponent::renderMesh()
+void chessComponent::clearInstances()
 {
-    // 1rst attribute buffer : vertices
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glVertexAttribPointer(
-        0,                  // attribute
-        3,                  // size
-        GL_FLOAT,           // type
-        GL_FALSE,           // normalized?
-        0,                  // stride
-        (void*)0            // array buffer offset
-    );
-
-    // 2nd attribute buffer : UVs
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glVertexAttribPointer(
-        1,                                // attribute
-        2,                                // size
-        GL_FLOAT,                         // type
-        GL_FALSE,                         // normalized?
-        0,                                // stride
-        (void*)0                          // array buffer offset
-    );
+    // Keeps the capacity, no allocation from frame to frame
+    instanceMatrices.clear();
+}
 
-    // 3rd attribute buffer : normals
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glVertexAttribPointer(
-        2,                                // attribute
-        3,                                // size
-        GL_FLOAT,                         // type
-        GL_FALSE,                         // normalized?
-        0,                                // stride
-        (void*)0                          // array buffer offset
-    );
+// Queue one more copy of the mesh for this frame
+// Inputs: Model matrix of the copy
+// Output: None
+void chessComponent::addInstance(const glm::mat4& ModelMatrix)
+{
+    instanceMatrices.push_back(ModelMatrix);
+}
 
-    // Index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+// Render all the queued instances with one draw call
+// Inputs: None
+// Output: None
+void chessComponent::renderInstances()
+{
+    if (instanceMatrices.empty())
+    {
+        return;
+    }
 
-    // Draw the triangles !
-    glDrawElements(
-        GL_TRIANGLES,      // mode
-        indices.size(),    // count
-        GL_UNSIGNED_SHORT,   // type
-        (void*)0           // element array buffer offset
+    // Upload this frame's model matrices (orphan the old storage, grow it if needed)
+    glBindBuffer(GL_ARRAY_BUFFER, instancebuffer);
+    if (instanceMatrices.size() > instanceCapacity)
+    {
+        instanceCapacity = instanceMatrices.capacity();
+    }
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceMatrices.size() * sizeof(glm::mat4), &instanceMatrices[0]);
+
+    // All the vertex state is in the VAO
+    glBindVertexArray(vertexArray);
+
+    // Draw the triangles of every instance !
+    glDrawElementsInstanced(
+        GL_TRIANGLES,               // mode
+        indexCount,                 // count
+        GL_UNSIGNED_SHORT,          // type
+        (void*)0,                   // element array buffer offset
+        instanceMatrices.size()     // instances
     );
-
-    // Disable the arrays
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
 }
 
 // Render a mesh
@@ -296,13 +433,27 @@ void chessComponent::renderMesh()
 // Output: None
 void chessComponent::deleteGLBuffers()
 {
+    // Nothing uploaded yet: no GL call (the loader threads make and copy components without a context)
+    if (vertexArray == 0 && Texture == 0)
+    {
+        return;
+    }
     // Cleanup VBO
+    glDeleteVertexArrays(1, &vertexArray);
     glDeleteBuffers(1, &vertexbuffer);
-    glDeleteBuffers(1, &uvbuffer);
-    glDeleteBuffers(1, &normalbuffer);
     glDeleteBuffers(1, &elementbuffer);
-    // Cleanup Texture buffer
-    glDeleteTextures(1, &Texture);
+    glDeleteBuffers(1, &instancebuffer);
+    vertexArray = 0;
+    vertexbuffer = 0;
+    elementbuffer = 0;
+    instancebuffer = 0;
+    // Give the Texture back, the cache deletes it with its last user
+    if (cTextures != nullptr)
+    {
+        cTextures->release(cTexturePath);
+    }
+    Texture = 0;
+    cTextures = nullptr;
 }
 
 // Stores a component ID
@@ -312,6 +463,9 @@ void chessComponent::storeComponentID(std::string cName)
 {
     // Capture the component name
     this->cName = cName;
+    // Name based placement rules, decided once here instead of every frame
+    cIsBoard = (this->cName == meshNames[MESH_BOARD]);
+    cTurnAround = (this->cName == meshNames[MESH_WHITE_KNIGHT] || this->cName == meshNames[MESH_WHITE_BISHOP]);
     // Testing
     // std::cout << "The child name is " << this->cName << std::endl;
 }
@@ -323,6 +477,11 @@ void chessComponent::storeTextureID(std::string cTextureFile)
 {
     // Capture the component name
     this->cTextureFile = cTextureFile;
+    // Update the Texture file name (since we only support bmps), once
+    if (!textureFilePath(this->cTextureFile, cTexturePath))
+    {
+        cTexturePath = "";
+    }
     // Testing
     // std::cout << "The texture file is " << this->cTextureFile << std::endl;
 }
@@ -335,11 +494,17 @@ void chessComponent::storeMeshProps(meshPropsT meshProps)
     this->meshProps = meshProps;
 }
 
-// Generate model matrix
-// Inputs: None
-// Output: None
-glm::mat4 chessComponent::genModelMatrix(tPosition& cTPosition)
+// Generate model matrix (rebuilt only when the piece moved, see tPosition::modelValid)
+// Inputs: Piece record, its cached matrix and bounds are updated
+// Output: Model matrix
+const glm::mat4& chessComponent::genModelMatrix(tPosition& cTPosition)
 {
+    // Unchanged since the last frame: nothing to do
+    if (cTPosition.modelValid)
+    {
+        return cTPosition.model;
+    }
+
     // Start with the Identity matrix
     glm::mat4 tModel = glm::mat4(1.0f);
     // Target World Coordinates
@@ -347,36 +512,42 @@ glm::mat4 chessComponent::genModelMatrix(tPosition& cTPosition)
     // Apply target rotation
     if (cTPosition.rAngle != 0.f)
     {
-        // Rotate Knight/Bishop by another 180 degree aroudn Z
-        if (cName == "Object3" || cName == "ALFIERE3")
-        {
-            tModel = glm::rotate(tModel, glm::radians(180.f), {0, 0, 1});
-        }
+        tModel = tModel * cMeshTurn;
         tModel = glm::rotate(tModel, glm::radians(cTPosition.rAngle), cTPosition.rAxis);
     }
     // Apply scaling
     tModel = glm::scale(tModel, cTPosition.cScale);
     // Pull it to origin first (with height adjusted to X/Z plane)!
-    // tModel = glm::translate(tModel, -cGeometricCener);
-    // We want the board surface to be in the X/Z plane. Need to move in -y direction
-    // equal to board's height.
-    if (cName == "12951_Stone_Chess_Board")
-    { // For Chess board eliminate the height by pushing it down by the height
-        // Apply the adjustment (Z is compensated to push the board down by depth)
-        tModel = glm::translate(tModel, {-cGeometricCener.x, -cGeometricCener.y, -cGeometricCener.z/2});
-    }
-    else
-    { // For all others get to X/Z plane with Y=0
-        tModel = glm::translate(tModel, {-cGeometricCener.x, 0.f, -cGeometricCener.z});
+    tModel = tModel * cMeshOffset;
+
+    // Cache the matrix and the world bounds until the piece moves again
+    cTPosition.model = tModel;
+    getWorldBounds(tModel, cTPosition.boundsCenter, cTPosition.boundsExtent);
+    cTPosition.modelValid = true;
+    return cTPosition.model;
+}
+
+// World space bounding box of one instance: the box of the transformed local box
+// Inputs: Model matrix of the instance
+// Output: Center and half size of the box
+void chessComponent::getWorldBounds(const glm::mat4& ModelMatrix, glm::vec3& center, glm::vec3& extent) const
+{
+    glm::vec3 localCenter = (cBoundingLimitsMin + cBoundingLimitsMax) * 0.5f;
+    glm::vec3 localExtent = (cBoundingLimitsMax - cBoundingLimitsMin) * 0.5f;
+    center = glm::vec3(ModelMatrix * glm::vec4(localCenter, 1.0f));
+    // Each world axis gets the local half sizes through the absolute rotation and scale
+    for (int i = 0; i < 3; i++)
+    {
+        extent[i] = fabsf(ModelMatrix[0][i]) * localExtent.x +
+                    fabsf(ModelMatrix[1][i]) * localExtent.y +
+                    fabsf(ModelMatrix[2][i]) * localExtent.z;
     }
-    // Return the matrix
-    return tModel;
 }
 
 // Get ID
 // Inputs: None
 // Output: ID
-std::string chessComponent::getComponentID()
+const std::string& chessComponent::getComponentID() const
 {
     return cName;
 }
@@ -21,6 +21,9 @@ Chess component class header file
 // Load BMP function support
 #include <common/texture.hpp>
 
+class assetBundle;
+class textureCache;
+
 class chessComponent
 {
 private:
@@ -30,35 +33,53 @@ private:
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec2> uvs;
     std::vector<glm::vec3> normals;
+    // Mesh already interleaved (from the mesh cache), used instead of the vectors above until setupGLBuffers
+    const vertexT* packedVertices = nullptr;
+    size_t packedVertexCount = 0;
+    const unsigned short* packedIndices = nullptr;
+    size_t packedIndexCount = 0;
+    GLsizei indexCount = 0;         // indices in the element buffer
 
     // OpenGL Buffers management
-    GLuint vertexbuffer = 0;
-    GLuint uvbuffer = 0;
-    GLuint normalbuffer = 0;
+    GLuint vertexArray = 0;         // VAO holding the vertex layout below
+    GLuint vertexbuffer = 0;        // interleaved vertexT data
     GLuint elementbuffer = 0;
+    GLuint instancebuffer = 0;
+
+    // Model matrices of the pieces drawn with this mesh in the current frame
+    std::vector<glm::mat4> instanceMatrices;
+    size_t instanceCapacity = 0;    // matrices the instance buffer can hold
 
     // Component ID
     std::string cName;
+    bool cIsBoard = false;      // the board is placed differently from the pieces
+    bool cTurnAround = false;   // white knight/bishop meshes face the wrong way
     std::string cTextureFile;
+    std::string cTexturePath;   // BMP file of the texture, resolved once from cTextureFile
 
     // Mesh properties
     meshPropsT meshProps;
     glm::vec3 cGeometricCener = { 0, 0, 0 };
     glm::vec3 cBoundingLimitsMin = { 0, 0, 0 };
     glm::vec3 cBoundingLimitsMax = { 0, 0, 0 };
+    bool cBoundsKnown = false;  // center and bounds given at load (asset bundle), not computed
+    // Static part of the model matrices, set at load
+    glm::mat4 cMeshOffset = glm::mat4(1.0f);    // centering of the mesh on its square
+    glm::mat4 cMeshTurn = glm::mat4(1.0f);      // extra half turn of the white knight/bishop
 
     // Texture properties
     GLuint Texture;
+    textureCache* cTextures = nullptr;  // holder of Texture, shared with the components using the same file
 
     // Compute the Geometric center
-    // Inputs: None
+    // Inputs: Interleaved vertices
     // Output: None
-    void getGeometricCenter();
+    void getGeometricCenter(const vertexT* vertexData, size_t vertexCount);
 
     // Compute the Bounding box
-    // Inputs: None
+    // Inputs: Interleaved vertices
     // Output: None
-    void getBoundingBox();
+    void getBoundingBox(const vertexT* vertexData, size_t vertexCount);
 
 
 public:
@@ -86,22 +107,51 @@ public:
     // Inputs: Face vertices read from OBJ file
     // Output: None
     void addFaceIndices(unsigned int *objFaceIndice);
+    // Use an interleaved mesh instead of the add functions above (mesh cache)
+    // Inputs: Vertices and face indices, they must stay valid until setupGLBuffers
+    // Output: None
+    void attachPackedMesh(const vertexT* vertexData, size_t vertexCount, const unsigned short* indexData, size_t indexCount);
+    // Interleave position, UV and normal of each vertex
+    // Inputs: None
+    // Output: Interleaved vertices
+    void packVertices(std::vector<vertexT> & packed) const;
+    // Store the geometric center and bounding box computed offline
+    // Inputs: Center, box min and max corners
+    // Output: None
+    void storeBounds(const glm::vec3 & center, const glm::vec3 & boundsMin, const glm::vec3 & boundsMax);
     // Setup rendering buffers
     // Inputs: None
     // Output: None
     void setupGLBuffers();
-    // Setup Texture buffers
-    // Inputs: None
+    // Setup Texture buffers: the texture of the file is shared when another component loaded it
+    // Inputs: Texture cache (must outlive the component), baked assets to take the texture from
+    //         (nullptr or texture not baked: BMP file)
     // Output: None
-    void setupTextureBuffers();
+    void setupTextureBuffers(textureCache & textures, const assetBundle* bundle = nullptr);
+    // File the texture is loaded from
+    // Inputs: None
+    // Output: Path of the BMP file, empty if the texture has no known file
+    const std::string& texturePath() const { return cTexturePath; }
     // Setup rendering buffers
     // Inputs: None
     // Output: None
-    void setupTexture(GLuint & TextureID);
-    // Render a mesh
+    void setupTexture(GLuint TextureID);
+    // Forget the instances queued for the last frame
     // Inputs: None
     // Output: None
-    void renderMesh();
+    void clearInstances();
+    // Queue one more copy of the mesh for this frame
+    // Inputs: Model matrix of the copy
+    // Output: None
+    void addInstance(const glm::mat4 & ModelMatrix);
+    // Number of instances queued
+    // Inputs: None
+    // Output: Count
+    size_t instanceCount() const { return instanceMatrices.size(); }
+    // Render all the queued instances with one draw call
+    // Inputs: None
+    // Output: None
+    void renderInstances();
     // Render a mesh
     // Inputs: None
     // Output: None
@@ -118,14 +168,30 @@ public:
     // Inputs: None
     // Output: None
     void storeMeshProps(meshPropsT meshProps);
-    // Generate model matrix
-    // Inputs: None
-    // Output: None
-    glm::mat4 genModelMatrix(tPosition & cTPosition);
+    // Generate model matrix (rebuilt only when the piece moved, see tPosition::modelValid)
+    // Inputs: Piece record, its cached matrix and bounds are updated
+    // Output: Model matrix
+    const glm::mat4& genModelMatrix(tPosition & cTPosition);
+    // World space bounding box of one instance
+    // Inputs: Model matrix of the instance
+    // Output: Center and half size of the box
+    void getWorldBounds(const glm::mat4 & ModelMatrix, glm::vec3 & center, glm::vec3 & extent) const;
     // Get ID
     // Inputs: None
     // Output: ID
-    std::string getComponentID();
+    const std::string& getComponentID() const;
+    // Get the Texture file name (as stored in the MTL file)
+    // Inputs: None
+    // Output: File name
+    const std::string& getTextureFile() const { return cTextureFile; }
+    // Get the Mesh properties
+    // Inputs: None
+    // Output: Mesh properties
+    const meshPropsT& getMeshProps() const { return meshProps; }
+    // Get the face indices added so far
+    // Inputs: None
+    // Output: Indices
+    const std::vector<unsigned short>& getIndices() const { return indices; }
 };
 
 #endif
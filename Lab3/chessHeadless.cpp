@@ -0,0 +1,223 @@
+/**
+ * @file chessHeadless.cpp
+ * @brief Offscreen rendering backend: an EGL context without a surface
+ *        (Mesa surfaceless platform, llvmpipe when there is no GPU) drawing
+ *        into a framebuffer object, and a PPM writer for the frames
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "chessHeadless.h"
+#include <cstdio>
+
+#ifdef CHESS_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/**
+ * @brief Open the surfaceless platform display, or the default display when
+ *        the implementation does not have it
+ *
+ * @return EGLDisplay
+ */
+static EGLDisplay openDisplay()
+{
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL)
+    {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY)
+            return display;
+    }
+#endif
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/**
+ * @brief Create a 3.3 core context with no surface and make it current
+ *
+ * @param ctx
+ * @return true
+ * @return false
+ */
+bool createHeadlessContext(headlessContextT& ctx)
+{
+    EGLDisplay display = openDisplay();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        fprintf(stderr, "Failed to initialize EGL\n");
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        fprintf(stderr, "EGL has no desktop OpenGL\n");
+        eglTerminate(display);
+        return false;
+    }
+
+    // No surface is ever created, but the default surface type (window) is not
+    // offered without a display server: ask for pbuffer configs
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+    {
+        fprintf(stderr, "No EGL config for OpenGL\n");
+        eglTerminate(display);
+        return false;
+    }
+
+    // Same version and profile as the window context
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        fprintf(stderr, "Failed to create a surfaceless OpenGL 3.3 context\n");
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    ctx.display = display;
+    ctx.context = context;
+    return true;
+}
+
+/**
+ * @brief Release the context
+ *
+ * @param ctx
+ */
+static void releaseContext(headlessContextT& ctx)
+{
+    if (ctx.display == NULL)
+        return;
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(ctx.display, ctx.context);
+    eglTerminate(ctx.display);
+    ctx.display = NULL;
+    ctx.context = NULL;
+}
+
+#else
+
+bool createHeadlessContext(headlessContextT&)
+{
+    fprintf(stderr, "Headless rendering needs EGL, this build has none\n");
+    return false;
+}
+
+static void releaseContext(headlessContextT&)
+{
+}
+
+#endif
+
+
+/**
+ * @brief Create the color and depth renderbuffers and bind the framebuffer
+ *        for drawing and reading
+ *
+ * @param ctx
+ * @param width
+ * @param height
+ * @return true
+ * @return false
+ */
+bool createOffscreenFramebuffer(headlessContextT& ctx, int width, int height)
+{
+    ctx.width = width;
+    ctx.height = height;
+
+    glGenRenderbuffers(1, &ctx.colorbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, ctx.colorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &ctx.depthbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, ctx.depthbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &ctx.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, ctx.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ctx.colorbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, ctx.depthbuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    ctx.pixels.resize((size_t)width * height * 3);
+    return true;
+}
+
+/**
+ * @brief Read back the framebuffer and write it as a binary PPM
+ *
+ * @param ctx
+ * @param path
+ * @return true
+ * @return false
+ */
+bool writeFramePPM(headlessContextT& ctx, const std::string& path)
+{
+    // Tightly packed RGB rows, bottom row first as OpenGL reads them
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, ctx.width, ctx.height, GL_RGB, GL_UNSIGNED_BYTE, ctx.pixels.data());
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", ctx.width, ctx.height);
+    size_t rowBytes = (size_t)ctx.width * 3;
+    bool written = true;
+    // PPM stores the top row first
+    for (int row = ctx.height - 1; row >= 0 && written; row--)
+    {
+        written = fwrite(ctx.pixels.data() + row * rowBytes, 1, rowBytes, file) == rowBytes;
+    }
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        fprintf(stderr, "Failed writing %s\n", path.c_str());
+    }
+    return written;
+}
+
+/**
+ * @brief Delete the framebuffer and release the context
+ *
+ * @param ctx
+ */
+void destroyHeadlessContext(headlessContextT& ctx)
+{
+    if (ctx.framebuffer != 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &ctx.framebuffer);
+        glDeleteRenderbuffers(1, &ctx.colorbuffer);
+        glDeleteRenderbuffers(1, &ctx.depthbuffer);
+        ctx.framebuffer = 0;
+    }
+    releaseContext(ctx);
+}
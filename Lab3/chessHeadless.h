@@ -0,0 +1,43 @@
+/*
+Objective:
+Offscreen OpenGL context and framebuffer for rendering without a window
+(CI runs and benchmarks on machines with no display)
+*/
+
+#ifndef CHESS_HEADLESS_H
+#define CHESS_HEADLESS_H
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+/**
+ * @brief Surfaceless context and the framebuffer object the frames are drawn into
+ *
+ */
+typedef struct
+{
+    void* display;          // EGLDisplay
+    void* context;          // EGLContext
+    GLuint framebuffer;
+    GLuint colorbuffer;
+    GLuint depthbuffer;
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;  // read back frame, reused between frames
+} headlessContextT;
+
+// Create a 3.3 core context with no surface and make it current (before glewInit)
+// Returns false if no EGL display can be opened or the build has no EGL
+bool createHeadlessContext(headlessContextT& ctx);
+
+// Create the framebuffer object of the given size and bind it (after glewInit)
+bool createOffscreenFramebuffer(headlessContextT& ctx, int width, int height);
+
+// Read back the framebuffer and write it as a binary PPM (P6), top row first
+bool writeFramePPM(headlessContextT& ctx, const std::string& path);
+
+// Delete the framebuffer and release the context
+void destroyHeadlessContext(headlessContextT& ctx);
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @file chessMoveGen.cpp
+ * @brief Legal move generator on the bitboard position
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "chessPosition.h"
+
+
+/**
+ * @brief Add a move for every target square
+ *
+ * @param list
+ * @param from
+ * @param targets
+ * @param enemies   squares of the opponent (sets the capture flag)
+ */
+static inline void addMoves(moveList& list, int from, bitboard targets, bitboard enemies)
+{
+    while (targets)
+    {
+        int to = popLSB(targets);
+        list.add(encodeMove(from, to, (enemies & squareBB(to)) ? CAPTURE : QUIET_MOVE));
+    }
+}
+
+/**
+ * @brief Add a pawn move, expanded to the four promotions on the last rank
+ *
+ * @param list
+ * @param from
+ * @param to
+ * @param flags
+ */
+static inline void addPawnMove(moveList& list, int from, int to, int flags)
+{
+    int row = squareRow(to);
+    if (row == 0 || row == 7)
+    {
+        int promo = (flags & CAPTURE) ? PROMOTION_CAPTURE : PROMOTION;
+        for (int t = QUEEN; t >= KNIGHT; t--)
+            list.add(encodeMove(from, to, promo + (t - KNIGHT)));
+    }
+    else
+    {
+        list.add(encodeMove(from, to, flags));
+    }
+}
+
+/**
+ * @brief Squares of our pieces pinned to our king by an opponent slider
+ *
+ * @param position
+ * @param us
+ * @param kingSq
+ * @return bitboard
+ */
+static bitboard pinnedPieces(const chessPosition& position, int us, int kingSq)
+{
+    const bitboard* them = position.pieces[us ^ 1];
+    bitboard pinned = 0;
+
+    // Opponent sliders that would attack the king on an empty board
+    bitboard snipers = (rookAttacks(kingSq, 0) & (them[ROOK] | them[QUEEN])) |
+                       (bishopAttacks(kingSq, 0) & (them[BISHOP] | them[QUEEN]));
+    while (snipers)
+    {
+        int sniper = popLSB(snipers);
+        bitboard blockers = betweenBB[kingSq][sniper] & position.occupied;
+
+        // Exactly one piece in between, and it is ours
+        if (blockers && !(blockers & (blockers - 1)) && (blockers & position.colors[us]))
+            pinned |= blockers;
+    }
+    return pinned;
+}
+
+/**
+ * @brief All legal moves of the side to move
+ *
+ * @param position
+ * @param list      filled with the moves (cleared first)
+ */
+void generateLegalMoves(const chessPosition& position, moveList& list)
+{
+    list.clear();
+
+    int us = position.sideToMove;
+    int them = us ^ 1;
+    const bitboard* ours = position.pieces[us];
+    bitboard own = position.colors[us];
+    bitboard enemies = position.colors[them];
+    bitboard occupied = position.occupied;
+    int kingSq = position.kingSquare(us);
+
+    bitboard checkers = position.attackersTo(kingSq, occupied) & enemies;
+
+    // King moves: the king is lifted off the board so it does not hide the squares behind it
+    bitboard kingOff = occupied ^ squareBB(kingSq);
+    bitboard kingTargets = kingAttacks[kingSq] & ~own;
+    while (kingTargets)
+    {
+        int to = popLSB(kingTargets);
+        if (!position.isSquareAttacked(to, them, kingOff))
+            list.add(encodeMove(kingSq, to, (enemies & squareBB(to)) ? CAPTURE : QUIET_MOVE));
+    }
+
+    // In double check only the king can move
+    if (checkers & (checkers - 1))
+        return;
+
+    // In check the other pieces must capture the checker or block the line to it
+    bitboard checkMask = ~0ULL;
+    if (checkers)
+        checkMask = checkers | betweenBB[kingSq][lsb(checkers)];
+
+    bitboard pinned = pinnedPieces(position, us, kingSq);
+    bitboard targetMask = ~own & checkMask;
+
+    // Knights (a pinned knight can never move)
+    bitboard b = ours[KNIGHT] & ~pinned;
+    while (b)
+    {
+        int from = popLSB(b);
+        addMoves(list, from, knightAttacks[from] & targetMask, enemies);
+    }
+
+    // Sliders (a pinned slider may move along the pin line)
+    b = ours[BISHOP] | ours[QUEEN];
+    while (b)
+    {
+        int from = popLSB(b);
+        bitboard targets = bishopAttacks(from, occupied) & targetMask;
+        if (pinned & squareBB(from))
+            targets &= lineBB[kingSq][from];
+        addMoves(list, from, targets, enemies);
+    }
+    b = ours[ROOK] | ours[QUEEN];
+    while (b)
+    {
+        int from = popLSB(b);
+        bitboard targets = rookAttacks(from, occupied) & targetMask;
+        if (pinned & squareBB(from))
+            targets &= lineBB[kingSq][from];
+        addMoves(list, from, targets, enemies);
+    }
+
+    // Pawns
+    int forward = (us == 0) ? 8 : -8;
+    int startRow = (us == 0) ? 1 : 6;
+    b = ours[PAWN];
+    while (b)
+    {
+        int from = popLSB(b);
+        bitboard allowed = checkMask;
+        if (pinned & squareBB(from))
+            allowed &= lineBB[kingSq][from];
+
+        // Pushes
+        int to = from + forward;
+        if (!(occupied & squareBB(to)))
+        {
+            if (allowed & squareBB(to))
+                addPawnMove(list, from, to, QUIET_MOVE);
+
+            int to2 = to + forward;
+            if (squareRow(from) == startRow && !(occupied & squareBB(to2)) && (allowed & squareBB(to2)))
+                list.add(encodeMove(from, to2, DOUBLE_PUSH));
+        }
+
+        // Captures
+        bitboard captures = pawnAttacks[us][from] & enemies & allowed;
+        while (captures)
+            addPawnMove(list, from, popLSB(captures), CAPTURE);
+
+        // En passant: play it on the occupancy and look for sliders hitting the king,
+        // this covers the pawn pinned along the rank as well as the check by the captured pawn
+        if (position.epSquare != NO_SQUARE && (pawnAttacks[us][from] & squareBB(position.epSquare)))
+        {
+            int victim = position.epSquare - forward;
+            bitboard after = (occupied ^ squareBB(from) ^ squareBB(victim)) | squareBB(position.epSquare);
+            const bitboard* opp = position.pieces[them];
+            bool exposed = (rookAttacks(kingSq, after) & (opp[ROOK] | opp[QUEEN])) ||
+                           (bishopAttacks(kingSq, after) & (opp[BISHOP] | opp[QUEEN]));
+            // Checks from non sliders must be resolved by the capture itself
+            bool resolves = !checkers || (checkers & squareBB(victim)) || (checkMask & squareBB(position.epSquare));
+            if (!exposed && resolves)
+                list.add(encodeMove(from, position.epSquare, EN_PASSANT));
+        }
+    }
+
+    // Castling: not out of, through or into check, with the squares between king and rook empty
+    if (!checkers)
+    {
+        int home = (us == 0) ? 0 : 56;
+        int kingSide = (us == 0) ? WHITE_OO : BLACK_OO;
+        int queenSide = (us == 0) ? WHITE_OOO : BLACK_OOO;
+
+        if ((position.castlingRights & kingSide) &&
+            !(occupied & (squareBB(home + 5) | squareBB(home + 6))) &&
+            !position.isSquareAttacked(home + 5, them, occupied) &&
+            !position.isSquareAttacked(home + 6, them, occupied))
+        {
+            list.add(encodeMove(home + 4, home + 6, KING_CASTLE));
+        }
+        if ((position.castlingRights & queenSide) &&
+            !(occupied & (squareBB(home + 1) | squareBB(home + 2) | squareBB(home + 3))) &&
+            !position.isSquareAttacked(home + 3, them, occupied) &&
+            !position.isSquareAttacked(home + 2, them, occupied))
+        {
+            list.add(encodeMove(home + 4, home + 2, QUEEN_CASTLE));
+        }
+    }
+}
@@ -0,0 +1,922 @@
+/**
+ * @file chessPosition.cpp
+ * @brief Bitboard position representation and attack tables
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cctype>
+#include <sstream>
+#include "chessPosition.h"
+
+// Attack tables for the non sliding pieces
+bitboard knightAttacks[NUM_SQUARES];
+bitboard kingAttacks[NUM_SQUARES];
+bitboard pawnAttacks[NUM_COLORS][NUM_SQUARES];
+
+// Ray directions: the first four walk towards higher squares, the last four towards lower
+typedef enum rayDirection { NORTH, NORTH_EAST, EAST, NORTH_WEST, SOUTH, SOUTH_WEST, WEST, SOUTH_EAST, NUM_DIRECTIONS } rayDirection;
+static const int rayStep[NUM_DIRECTIONS][2] = {{1, 0}, {1, 1}, {0, 1}, {1, -1}, {-1, 0}, {-1, -1}, {0, -1}, {-1, 1}};
+// All the squares from a square to the edge of the board (exclusive of the square)
+static bitboard rays[NUM_DIRECTIONS][NUM_SQUARES];
+bitboard betweenBB[NUM_SQUARES][NUM_SQUARES];
+bitboard lineBB[NUM_SQUARES][NUM_SQUARES];
+
+// Zobrist keys
+uint64_t zobristPieces[NUM_COLORS][NUM_PIECE_TYPES][NUM_SQUARES];
+uint64_t zobristCastling[16];
+uint64_t zobristEnPassant[8];
+uint64_t zobristSide;
+
+// Castling rights kept when a piece moves from or to a square (rooks and kings home squares clear them)
+static int castlingMask[NUM_SQUARES];
+
+// Magic bitboard tables
+// Sizes are the sum over all squares of 2^(relevant bits): 102400 for rooks, 5248 for bishops
+magicEntry bishopMagics[NUM_SQUARES];
+magicEntry rookMagics[NUM_SQUARES];
+static bitboard bishopTable[5248];
+static bitboard rookTable[102400];
+
+// Magic numbers for each square, found with the search in initMagics() (seeded per rank).
+// Loading them avoids the search on every start.
+static const bitboard bishopMagicNumbers[NUM_SQUARES] = {
+    0x40106000A1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL, 0x002806004050C040ULL,
+    0x0002021018000000ULL, 0x2001112010000400ULL, 0x0881010120218080ULL, 0x1030820110010500ULL,
+    0x0000120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422A02000001ULL,
+    0x000A220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL, 0x0100004042101040ULL,
+    0x0004001004082820ULL, 0x0010000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+    0x0040880C00A00100ULL, 0x0080400200522010ULL, 0x0001000188180B04ULL, 0x0080249202020204ULL,
+    0x1004400004100410ULL, 0x00013100A0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+    0x4020848004002000ULL, 0x10101380D1004100ULL, 0x0008004422020284ULL, 0x01010A1041008080ULL,
+    0x0808080400082121ULL, 0x0808080400082121ULL, 0x0091128200100C00ULL, 0x0202200802010104ULL,
+    0x8C0A020200440085ULL, 0x01A0008080B10040ULL, 0x0889520080122800ULL, 0x100902022202010AULL,
+    0x04081A0816002000ULL, 0x0000681208005000ULL, 0x8170840041008802ULL, 0x0A00004200810805ULL,
+    0x0830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+    0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440A210428ULL, 0x0008240020880021ULL,
+    0x0400002012048200ULL, 0x00AC102001210220ULL, 0x0220021002009900ULL, 0x84440C080A013080ULL,
+    0x0001008044200440ULL, 0x0004C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+    0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822C08200ULL, 0x48081010008A2A80ULL
+};
+static const bitboard rookMagicNumbers[NUM_SQUARES] = {
+    0x0880004000108025ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+    0xC200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+    0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+    0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+    0x0040048001458024ULL, 0x00A0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+    0x5004808008000401ULL, 0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+    0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL, 0x0000100080080080ULL,
+    0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xC020128200040545ULL,
+    0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+    0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490A000084ULL,
+    0x0080002000504000ULL, 0x200020005000C000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+    0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+    0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+    0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+    0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+    0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL, 0x4048240043802106ULL
+};
+
+
+/**
+ * @brief Colour of a piece identity
+ *
+ * @param p
+ * @return int white=0, black=1, EMPTY=-1
+ */
+int pieceColor(piece p)
+{
+    if (p == EMPTY)
+        return -1;
+    return (p >= BLACK_PAWN_1) ? 1 : 0;
+}
+
+/**
+ * @brief Kind of a piece identity as set up at the start of the game
+ *
+ * @param p
+ * @return pieceType
+ */
+pieceType pieceTypeOf(piece p)
+{
+    if (p == EMPTY)
+        return NO_PIECE_TYPE;
+
+    // Both colours share the same layout in the enum
+    int id = (p >= BLACK_PAWN_1) ? p - BLACK_PAWN_1 : p - WHITE_PAWN_1;
+    if (id <= WHITE_PAWN_8)   return PAWN;
+    if (id <= WHITE_ROOK_2)   return ROOK;
+    if (id <= WHITE_KNIGHT_2) return KNIGHT;
+    if (id <= WHITE_BISHOP_2) return BISHOP;
+    if (id == WHITE_QUEEN)    return QUEEN;
+    return KING;
+}
+
+/**
+ * @brief Set the bit of (row + dRow, col + dCol) if it lies on the board
+ *
+ * @param b
+ * @param row
+ * @param col
+ * @param dRow
+ * @param dCol
+ */
+static void addIfOnBoard(bitboard& b, int row, int col, int dRow, int dCol)
+{
+    int r = row + dRow;
+    int c = col + dCol;
+    if (r >= 0 && r < 8 && c >= 0 && c < 8)
+        b |= squareBB(makeSquare(r, c));
+}
+
+/**
+ * @brief Attacks along one ray, stopping at (and including) the first blocker
+ *
+ * @param dir
+ * @param sq
+ * @param occupancy
+ * @return bitboard
+ */
+static inline bitboard rayAttacks(int dir, int sq, bitboard occupancy)
+{
+    bitboard attacks = rays[dir][sq];
+    bitboard blockers = attacks & occupancy;
+    if (blockers)
+    {
+        // Nearest blocker is the lowest bit on increasing rays, the highest on decreasing ones
+        int blocker = (dir < SOUTH) ? lsb(blockers) : msb(blockers);
+        attacks ^= rays[dir][blocker];
+    }
+    return attacks;
+}
+
+/**
+ * @brief Bishop attacks for the given occupancy, walking the rays
+ *
+ * @param sq
+ * @param occupancy
+ * @return bitboard
+ */
+bitboard bishopAttacksRay(int sq, bitboard occupancy)
+{
+    return rayAttacks(NORTH_EAST, sq, occupancy) | rayAttacks(NORTH_WEST, sq, occupancy) |
+           rayAttacks(SOUTH_EAST, sq, occupancy) | rayAttacks(SOUTH_WEST, sq, occupancy);
+}
+
+/**
+ * @brief Rook attacks for the given occupancy, walking the rays
+ *
+ * @param sq
+ * @param occupancy
+ * @return bitboard
+ */
+bitboard rookAttacksRay(int sq, bitboard occupancy)
+{
+    return rayAttacks(NORTH, sq, occupancy) | rayAttacks(SOUTH, sq, occupancy) |
+           rayAttacks(EAST, sq, occupancy) | rayAttacks(WEST, sq, occupancy);
+}
+
+
+/**
+ * @brief Small xorshift generator for the magic search and the Zobrist keys
+ *        (fixed seed, so the tables are identical on every start)
+ *
+ */
+class magicRandom {
+    uint64_t state;
+public:
+    explicit magicRandom(uint64_t seed) : state(seed) {}
+    uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+    // Magics with few set bits are found much faster
+    uint64_t sparse() { return next() & next() & next(); }
+};
+
+/**
+ * @brief Fill one square's attack table slice with its magic number
+ *
+ * @param m
+ * @param occupancies   all subsets of the mask
+ * @param references    attacks for each subset
+ * @param size          number of subsets
+ * @param epoch         per index stamp of the last attempt that wrote it
+ * @param attempt       stamp of this attempt
+ * @return true if no two subsets with different attacks share an index
+ */
+static bool fillMagicTable(magicEntry& m, const bitboard* occupancies, const bitboard* references, int size, int* epoch, int attempt)
+{
+    for (int i = 0; i < size; i++)
+    {
+        unsigned int idx = magicIndex(m, occupancies[i]);
+        if (epoch[idx] < attempt)
+        {
+            epoch[idx] = attempt;
+            m.attacks[idx] = references[i];
+        }
+        else if (m.attacks[idx] != references[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Fill the attack table of one slider from its magic numbers,
+ *        searching for a new magic if a stored one does not fit
+ *
+ * @param magics        per square lookup data to fill
+ * @param table         shared attack table (all squares, back to back)
+ * @param knownMagics   magic number of each square
+ * @param slowAttacks   ray walk used as the reference
+ */
+static void initMagics(magicEntry* magics, bitboard* table, const bitboard* knownMagics, bitboard (*slowAttacks)(int, bitboard))
+{
+    // Every occupancy subset of the largest mask (rook in a corner has 12 bits)
+    static bitboard occupancies[4096];
+    static bitboard references[4096];
+    static int epoch[4096];
+    static int attempt = 0;
+    // Per rank seeds of the magic search
+    const uint64_t magicSeeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+    bitboard* next = table;
+    for (int sq = 0; sq < NUM_SQUARES; sq++)
+    {
+        magicEntry& m = magics[sq];
+
+        // Board edges never block a ray (unless the piece stands on them), drop them from the mask
+        bitboard edges = ((0x00000000000000FFULL | 0xFF00000000000000ULL) & ~(0x00000000000000FFULL << (8 * squareRow(sq)))) |
+                         ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << squareCol(sq)));
+        m.mask = slowAttacks(sq, 0) & ~edges;
+        m.shift = 64 - popCount(m.mask);
+        m.attacks = next;
+
+        // Enumerate all subsets of the mask (Carry-Rippler trick)
+        int size = 0;
+        bitboard b = 0;
+        do {
+            occupancies[size] = b;
+            references[size] = slowAttacks(sq, b);
+            size++;
+            b = (b - m.mask) & m.mask;
+        } while (b);
+        next += size;
+
+#ifdef CHESS_USE_PEXT
+        // PEXT is a perfect hash, no magic needed
+        m.magic = 0;
+        fillMagicTable(m, occupancies, references, size, epoch, ++attempt);
+#else
+        m.magic = knownMagics[sq];
+        if (fillMagicTable(m, occupancies, references, size, epoch, ++attempt))
+            continue;
+
+        // Try random sparse numbers until every subset maps without a destructive collision
+        magicRandom rng(magicSeeds[squareRow(sq)]);
+        do {
+            // The top byte of the product must be dense enough to spread the indices
+            do {
+                m.magic = rng.sparse();
+            } while (popCount((m.mask * m.magic) >> 56) < 6);
+        } while (!fillMagicTable(m, occupancies, references, size, epoch, ++attempt));
+#endif
+    }
+}
+
+/**
+ * @brief Fill the attack tables
+ *
+ */
+static bool buildTables()
+{
+    const int knightSteps[8][2] = {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
+    const int kingSteps[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+
+    for (int sq = 0; sq < NUM_SQUARES; sq++)
+    {
+        int row = squareRow(sq);
+        int col = squareCol(sq);
+
+        knightAttacks[sq] = kingAttacks[sq] = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            addIfOnBoard(knightAttacks[sq], row, col, knightSteps[i][0], knightSteps[i][1]);
+            addIfOnBoard(kingAttacks[sq], row, col, kingSteps[i][0], kingSteps[i][1]);
+        }
+
+        // Pawns capture diagonally forward (white up the rows, black down)
+        pawnAttacks[0][sq] = pawnAttacks[1][sq] = 0;
+        addIfOnBoard(pawnAttacks[0][sq], row, col, 1, -1);
+        addIfOnBoard(pawnAttacks[0][sq], row, col, 1, 1);
+        addIfOnBoard(pawnAttacks[1][sq], row, col, -1, -1);
+        addIfOnBoard(pawnAttacks[1][sq], row, col, -1, 1);
+
+        // Walk each ray to the edge of the board
+        for (int dir = 0; dir < NUM_DIRECTIONS; dir++)
+        {
+            rays[dir][sq] = 0;
+            for (int r = row + rayStep[dir][0], c = col + rayStep[dir][1];
+                 r >= 0 && r < 8 && c >= 0 && c < 8;
+                 r += rayStep[dir][0], c += rayStep[dir][1])
+            {
+                rays[dir][sq] |= squareBB(makeSquare(r, c));
+            }
+        }
+    }
+
+    // Lines and segments between aligned squares
+    for (int a = 0; a < NUM_SQUARES; a++)
+    {
+        for (int b = 0; b < NUM_SQUARES; b++)
+        {
+            betweenBB[a][b] = lineBB[a][b] = 0;
+        }
+        for (int dir = 0; dir < NUM_DIRECTIONS; dir++)
+        {
+            // Opposite direction of dir is dir +/- 4
+            int back = (dir + 4) % NUM_DIRECTIONS;
+            bitboard ray = rays[dir][a];
+            while (ray)
+            {
+                int b = popLSB(ray);
+                betweenBB[a][b] = rays[dir][a] & rays[back][b];
+                lineBB[a][b] = rays[dir][a] | rays[back][a] | squareBB(a);
+            }
+        }
+    }
+
+    for (int sq = 0; sq < NUM_SQUARES; sq++)
+        castlingMask[sq] = WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO;
+    castlingMask[makeSquare(0, 0)] &= ~WHITE_OOO;
+    castlingMask[makeSquare(0, 7)] &= ~WHITE_OO;
+    castlingMask[makeSquare(0, 4)] &= ~(WHITE_OO | WHITE_OOO);
+    castlingMask[makeSquare(7, 0)] &= ~BLACK_OOO;
+    castlingMask[makeSquare(7, 7)] &= ~BLACK_OO;
+    castlingMask[makeSquare(7, 4)] &= ~(BLACK_OO | BLACK_OOO);
+
+    // Zobrist keys
+    magicRandom rng(1070372);
+    for (int c = 0; c < NUM_COLORS; c++)
+        for (int t = 0; t < NUM_PIECE_TYPES; t++)
+            for (int sq = 0; sq < NUM_SQUARES; sq++)
+                zobristPieces[c][t][sq] = rng.next();
+    for (int i = 0; i < 16; i++)
+        zobristCastling[i] = rng.next();
+    for (int i = 0; i < 8; i++)
+        zobristEnPassant[i] = rng.next();
+    zobristSide = rng.next();
+
+    // The magic tables are filled from the ray walks above
+    initMagics(bishopMagics, bishopTable, bishopMagicNumbers, bishopAttacksRay);
+    initMagics(rookMagics, rookTable, rookMagicNumbers, rookAttacksRay);
+    return true;
+}
+
+/**
+ * @brief Build the attack tables (including the magic tables), safe to call more than once
+ *
+ */
+void initBitboards()
+{
+    // Thread safe one time initialization
+    static const bool tablesReady = buildTables();
+    (void)tablesReady;
+}
+
+/**
+ * @brief Construct a new chessPosition object
+ *
+ */
+chessPosition::chessPosition()
+{
+    initBitboards();
+    clear();
+}
+
+/**
+ * @brief Remove all the pieces and reset the game state
+ *
+ */
+void chessPosition::clear()
+{
+    for (int c = 0; c < NUM_COLORS; c++)
+    {
+        colors[c] = 0;
+        for (int t = 0; t < NUM_PIECE_TYPES; t++)
+            pieces[c][t] = 0;
+    }
+    occupied = 0;
+
+    for (int sq = 0; sq < NUM_SQUARES; sq++)
+    {
+        squares[sq] = EMPTY;
+        types[sq] = NO_PIECE_TYPE;
+    }
+
+    sideToMove = 0;
+    castlingRights = 0;
+    epSquare = NO_SQUARE;
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+    key = computeKey();
+}
+
+/**
+ * @brief Place a piece identity of the given type on an empty square
+ *
+ * @param p
+ * @param t
+ * @param sq
+ */
+void chessPosition::putPiece(piece p, pieceType t, int sq)
+{
+    bitboard b = squareBB(sq);
+    int c = pieceColor(p);
+
+    pieces[c][t] |= b;
+    colors[c] |= b;
+    occupied |= b;
+    squares[sq] = p;
+    types[sq] = t;
+    key ^= zobristPieces[c][t][sq];
+}
+
+/**
+ * @brief Remove the piece on a square
+ *
+ * @param sq
+ * @return piece the removed identity (EMPTY if the square was empty)
+ */
+piece chessPosition::removePiece(int sq)
+{
+    piece p = squares[sq];
+    if (p == EMPTY)
+        return EMPTY;
+
+    bitboard b = squareBB(sq);
+    int c = pieceColor(p);
+
+    pieces[c][types[sq]] ^= b;
+    colors[c] ^= b;
+    occupied ^= b;
+    key ^= zobristPieces[c][types[sq]][sq];
+    squares[sq] = EMPTY;
+    types[sq] = NO_PIECE_TYPE;
+    return p;
+}
+
+/**
+ * @brief Relocate the piece on "from" to the empty square "to"
+ *
+ * @param from
+ * @param to
+ */
+void chessPosition::movePiece(int from, int to)
+{
+    piece p = squares[from];
+    pieceType t = types[from];
+    bitboard fromTo = squareBB(from) | squareBB(to);
+    int c = pieceColor(p);
+
+    pieces[c][t] ^= fromTo;
+    colors[c] ^= fromTo;
+    occupied ^= fromTo;
+    squares[to] = p;
+    types[to] = t;
+    squares[from] = EMPTY;
+    types[from] = NO_PIECE_TYPE;
+    key ^= zobristPieces[c][t][from] ^ zobristPieces[c][t][to];
+}
+
+/**
+ * @brief All pieces (both colours) attacking a square for the given occupancy
+ *
+ * @param sq
+ * @param occupancy
+ * @return bitboard
+ */
+bitboard chessPosition::attackersTo(int sq, bitboard occupancy) const
+{
+    bitboard diagonal = pieces[0][BISHOP] | pieces[1][BISHOP] | pieces[0][QUEEN] | pieces[1][QUEEN];
+    bitboard straight = pieces[0][ROOK] | pieces[1][ROOK] | pieces[0][QUEEN] | pieces[1][QUEEN];
+
+    // A white pawn attacks sq if a black pawn on sq would attack the white pawn's square (and vice versa)
+    return (pawnAttacks[1][sq] & pieces[0][PAWN]) |
+           (pawnAttacks[0][sq] & pieces[1][PAWN]) |
+           (knightAttacks[sq] & (pieces[0][KNIGHT] | pieces[1][KNIGHT])) |
+           (kingAttacks[sq] & (pieces[0][KING] | pieces[1][KING])) |
+           (bishopAttacks(sq, occupancy) & diagonal) |
+           (rookAttacks(sq, occupancy) & straight);
+}
+
+/**
+ * @brief Is the square attacked by any piece of the colour "byColor"?
+ *
+ * @param sq
+ * @param byColor
+ * @param occupancy
+ * @return true
+ * @return false
+ */
+bool chessPosition::isSquareAttacked(int sq, int byColor, bitboard occupancy) const
+{
+    const bitboard* them = pieces[byColor];
+
+    // Cheapest tests first
+    if (pawnAttacks[byColor ^ 1][sq] & them[PAWN])     return true;
+    if (knightAttacks[sq] & them[KNIGHT])              return true;
+    if (kingAttacks[sq] & them[KING])                  return true;
+    if (bishopAttacks(sq, occupancy) & (them[BISHOP] | them[QUEEN])) return true;
+    if (rookAttacks(sq, occupancy) & (them[ROOK] | them[QUEEN]))     return true;
+    return false;
+}
+
+/**
+ * @brief Play a legal move (from generateLegalMoves) for the side to move
+ *
+ * @param m
+ * @param undo  filled with the state needed by unmakeMove
+ */
+void chessPosition::makeMove(chessMove m, undoRecord& undo)
+{
+    int us = sideToMove;
+    int from = moveFrom(m);
+    int to = moveTo(m);
+    int flags = moveFlags(m);
+    bool pawnMove = (types[from] == PAWN);
+
+    undo.key = key;
+    undo.castlingRights = (int8_t)castlingRights;
+    undo.epSquare = (int8_t)epSquare;
+    undo.halfmoveClock = (int16_t)halfmoveClock;
+    undo.captured = EMPTY;
+    undo.capturedType = NO_PIECE_TYPE;
+
+    // Take the old castling rights and en passant file out of the key
+    key ^= zobristCastling[castlingRights];
+    if (epSquare != NO_SQUARE)
+        key ^= zobristEnPassant[squareCol(epSquare)];
+
+    // Remove the captured piece (the en passant victim is behind the target square)
+    if (flags & CAPTURE)
+    {
+        int capturedSq = (flags == EN_PASSANT) ? makeSquare(squareRow(from), squareCol(to)) : to;
+        undo.capturedType = types[capturedSq];
+        undo.captured = removePiece(capturedSq);
+    }
+
+    movePiece(from, to);
+
+    // The pawn keeps its identity (and its tModelMap entry) when promoted
+    if (flags & PROMOTION)
+    {
+        piece p = removePiece(to);
+        putPiece(p, promotionType(m), to);
+    }
+
+    // Castling also moves the rook next to the king
+    if (flags == KING_CASTLE)
+        movePiece(to + 1, to - 1);
+    else if (flags == QUEEN_CASTLE)
+        movePiece(to - 2, to + 1);
+
+    castlingRights &= castlingMask[from] & castlingMask[to];
+    epSquare = (flags == DOUBLE_PUSH) ? (from + to) / 2 : NO_SQUARE;
+    halfmoveClock = (pawnMove || (flags & CAPTURE)) ? 0 : halfmoveClock + 1;
+    if (us == 1)
+        fullmoveNumber++;
+    sideToMove = us ^ 1;
+
+    // Put the new state back in the key
+    key ^= zobristCastling[castlingRights] ^ zobristSide;
+    if (epSquare != NO_SQUARE)
+        key ^= zobristEnPassant[squareCol(epSquare)];
+}
+
+/**
+ * @brief Take back the last move played with makeMove
+ *
+ * @param m
+ * @param undo  the record filled by makeMove
+ */
+void chessPosition::unmakeMove(chessMove m, const undoRecord& undo)
+{
+    int from = moveFrom(m);
+    int to = moveTo(m);
+    int flags = moveFlags(m);
+
+    sideToMove ^= 1;
+    if (sideToMove == 1)
+        fullmoveNumber--;
+
+    // Put the castling rook back in its corner
+    if (flags == KING_CASTLE)
+        movePiece(to - 1, to + 1);
+    else if (flags == QUEEN_CASTLE)
+        movePiece(to + 1, to - 2);
+
+    // Demote back to a pawn
+    if (flags & PROMOTION)
+    {
+        piece p = removePiece(to);
+        putPiece(p, PAWN, to);
+    }
+
+    movePiece(to, from);
+
+    if (flags & CAPTURE)
+    {
+        int capturedSq = (flags == EN_PASSANT) ? makeSquare(squareRow(from), squareCol(to)) : to;
+        putPiece(undo.captured, undo.capturedType, capturedSq);
+    }
+
+    castlingRights = undo.castlingRights;
+    epSquare = undo.epSquare;
+    halfmoveClock = undo.halfmoveClock;
+    key = undo.key;
+}
+
+/**
+ * @brief UCI notation of a move
+ *
+ * @param m
+ * @return std::string e.g. "e2e4", "e7e8q"
+ */
+std::string moveToUCI(chessMove m)
+{
+    std::string uci;
+    uci += (char)('a' + squareCol(moveFrom(m)));
+    uci += (char)('1' + squareRow(moveFrom(m)));
+    uci += (char)('a' + squareCol(moveTo(m)));
+    uci += (char)('1' + squareRow(moveTo(m)));
+    if (isPromotion(m))
+        uci += "nbrq"[promotionType(m) - KNIGHT];
+    return uci;
+}
+
+/**
+ * @brief Parse a FEN clock field, all digits
+ *
+ * @param field
+ * @param value
+ * @return true if the field is a number
+ */
+static bool parseClock(const std::string& field, int& value)
+{
+    if (field.empty() || field.size() > 9 || field.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    value = std::stoi(field);
+    return true;
+}
+
+/**
+ * @brief Set up the position from a FEN string
+ *        Piece identities are handed out in enum order per type and colour;
+ *        pieces beyond the starting count (promoted pieces) take a free pawn identity
+ *
+ * @param fen
+ * @return true 
+ * @return false if the FEN can not be parsed, or contradicts the board: not one king per side,
+ *         a pawn on rank 1 or 8, a castling right without its king and rook at home, an en passant
+ *         square that is occupied, on the wrong rank or with no pawn behind it, the side not to move
+ *         in check, ranks that do not cover the board, a bad side or clock field, or a halfmove clock
+ *         above MAX_FEN_HALFMOVE_CLOCK (the position is left cleared)
+ */
+bool chessPosition::loadFEN(const std::string& fen)
+{
+    std::istringstream ss(fen);
+    std::string placement, side, castling, ep, halfmoveField, fullmoveField, extra;
+    int halfmove = 0, fullmove = 1;
+    ss >> placement >> side >> castling >> ep >> halfmoveField >> fullmoveField >> extra;
+
+    clear();
+    if (placement.empty() || (side != "w" && side != "b") || !extra.empty())
+        return false;
+    // The clocks may be left out, but when given they are plain numbers
+    if ((!halfmoveField.empty() && !parseClock(halfmoveField, halfmove)) ||
+        (!fullmoveField.empty() && !parseClock(fullmoveField, fullmove)) || halfmove > MAX_FEN_HALFMOVE_CLOCK)
+        return false;
+
+    // First identity and number of identities of each piece type
+    const int firstId[NUM_PIECE_TYPES] = {WHITE_PAWN_1, WHITE_KNIGHT_1, WHITE_BISHOP_1, WHITE_ROOK_1, WHITE_QUEEN, WHITE_KING};
+    const int idCount[NUM_PIECE_TYPES] = {8, 2, 2, 2, 1, 1};
+    int used[NUM_COLORS][NUM_PIECE_TYPES] = {};
+    int promoted[NUM_COLORS] = {};
+    const std::string letters = "pnbrqk";
+
+    int row = 7, col = 0;
+    for (char ch : placement)
+    {
+        if (ch == '/')
+        {
+            // Each rank covers the 8 files
+            if (col != 8 || row == 0)
+            {
+                clear();
+                return false;
+            }
+            row--;
+            col = 0;
+        }
+        else if (ch >= '1' && ch <= '8')
+        {
+            col += ch - '0';
+            if (col > 8)
+            {
+                clear();
+                return false;
+            }
+        }
+        else
+        {
+            size_t t = letters.find((char)tolower(ch));
+            if (t == std::string::npos || col > 7)
+            {
+                clear();
+                return false;
+            }
+            int c = isupper(ch) ? 0 : 1;
+            int base = (c == 0) ? WHITE_PAWN_1 : BLACK_PAWN_1;
+            // Pawn identities taken by promoted pieces are not available to pawns
+            int available = (t == PAWN) ? idCount[t] - promoted[c] : idCount[t];
+            int id;
+            if (used[c][t] < available)
+            {
+                id = firstId[t] + used[c][t]++;
+            }
+            else
+            {
+                // A promoted piece, use the identity of a pawn that is no longer on the board
+                if (t == KING || used[c][PAWN] + promoted[c] >= 8)
+                {
+                    clear();
+                    return false;
+                }
+                id = WHITE_PAWN_8 - promoted[c]++;
+            }
+            putPiece((piece)(base + id), (pieceType)t, makeSquare(row, col));
+            col++;
+        }
+    }
+
+    // Exactly 8 ranks
+    if (row != 0 || col != 8)
+    {
+        clear();
+        return false;
+    }
+
+    // Both kings must be on the board
+    if (used[0][KING] != 1 || used[1][KING] != 1)
+    {
+        clear();
+        return false;
+    }
+
+    // The side that just moved can not be left in check (its king would be captured)
+    sideToMove = (side == "b") ? 1 : 0;
+    if (isSquareAttacked(kingSquare(sideToMove ^ 1), sideToMove, occupied))
+    {
+        clear();
+        return false;
+    }
+
+    // No pawn on the first or last rank (makeMove shifts pawns off the board from there)
+    const bitboard backRanks = 0xFF000000000000FFULL;
+    if ((pieces[0][PAWN] | pieces[1][PAWN]) & backRanks)
+    {
+        clear();
+        return false;
+    }
+
+    for (char ch : castling)
+    {
+        if (ch == 'K') castlingRights |= WHITE_OO;
+        if (ch == 'Q') castlingRights |= WHITE_OOO;
+        if (ch == 'k') castlingRights |= BLACK_OO;
+        if (ch == 'q') castlingRights |= BLACK_OOO;
+    }
+    // A castling right needs its king and rook on their home squares
+    const int rights[4] = {WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO};
+    const int rookCol[4] = {7, 0, 7, 0};
+    for (int r = 0; r < 4; r++)
+    {
+        int c = r / 2;
+        int homeRow = (c == 0) ? 0 : 7;
+        if ((castlingRights & rights[r]) &&
+            (!(pieces[c][KING] & squareBB(makeSquare(homeRow, 4))) || !(pieces[c][ROOK] & squareBB(makeSquare(homeRow, rookCol[r])))))
+        {
+            clear();
+            return false;
+        }
+    }
+    if (ep.length() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] >= '1' && ep[1] <= '8')
+    {
+        // Empty, on the sixth rank of the side to move, behind a pawn that just moved two squares
+        int epRow = ep[1] - '1';
+        int epCol = ep[0] - 'a';
+        int pawnRow = (sideToMove == 0) ? 4 : 3;
+        if (epRow != ((sideToMove == 0) ? 5 : 2) || squares[makeSquare(epRow, epCol)] != EMPTY ||
+            !(pieces[sideToMove ^ 1][PAWN] & squareBB(makeSquare(pawnRow, epCol))))
+        {
+            clear();
+            return false;
+        }
+        epSquare = makeSquare(epRow, epCol);
+    }
+    else if (ep != "-" && !ep.empty())
+    {
+        clear();
+        return false;
+    }
+    halfmoveClock = halfmove;
+    fullmoveNumber = fullmove;
+    key = computeKey();
+    return true;
+}
+
+/**
+ * @brief FEN string of the position
+ *
+ * @return std::string
+ */
+std::string chessPosition::toFEN() const
+{
+    const char letters[NUM_COLORS][NUM_PIECE_TYPES + 1] = {"PNBRQK", "pnbrqk"};
+    std::string fen;
+
+    for (int row = 7; row >= 0; row--)
+    {
+        int empty = 0;
+        for (int col = 0; col < 8; col++)
+        {
+            int sq = makeSquare(row, col);
+            if (squares[sq] == EMPTY)
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+                fen += (char)('0' + empty);
+            empty = 0;
+            fen += letters[pieceColor(squares[sq])][types[sq]];
+        }
+        if (empty)
+            fen += (char)('0' + empty);
+        if (row > 0)
+            fen += '/';
+    }
+
+    fen += (sideToMove == 0) ? " w " : " b ";
+    if (castlingRights == 0)
+        fen += '-';
+    if (castlingRights & WHITE_OO)  fen += 'K';
+    if (castlingRights & WHITE_OOO) fen += 'Q';
+    if (castlingRights & BLACK_OO)  fen += 'k';
+    if (castlingRights & BLACK_OOO) fen += 'q';
+
+    if (epSquare == NO_SQUARE)
+    {
+        fen += " -";
+    }
+    else
+    {
+        fen += ' ';
+        fen += (char)('a' + squareCol(epSquare));
+        fen += (char)('1' + squareRow(epSquare));
+    }
+
+    fen += " " + std::to_string(halfmoveClock) + " " + std::to_string(fullmoveNumber);
+    return fen;
+}
+
+/**
+ * @brief Zobrist key of the position computed from scratch
+ *
+ * @return uint64_t
+ */
+uint64_t chessPosition::computeKey() const
+{
+    uint64_t key = 0;
+    bitboard b = occupied;
+    while (b)
+    {
+        int sq = popLSB(b);
+        key ^= zobristPieces[pieceColor(squares[sq])][types[sq]][sq];
+    }
+    key ^= zobristCastling[castlingRights];
+    if (epSquare != NO_SQUARE)
+        key ^= zobristEnPassant[squareCol(epSquare)];
+    if (sideToMove == 1)
+        key ^= zobristSide;
+    return key;
+}
@@ -0,0 +1,271 @@
+/*
+Objective:
+Bitboard position representation for the Game of Chess
+*/
+
+#ifndef CHESS_POSITION_H
+#define CHESS_POSITION_H
+
+#include <cstdint>
+#include <string>
+#include "chessCommon.h"
+
+// PEXT replaces the magic multiply when the compiler targets BMI2 (-mbmi2)
+#if defined(__BMI2__)
+#include <immintrin.h>
+#define CHESS_USE_PEXT
+#endif
+
+// One bit per square of the board
+// Square index = row * 8 + col (a1 = 0, h1 = 7, a8 = 56, h8 = 63)
+typedef uint64_t bitboard;
+
+/**
+ * @brief Enum for the kind of a chess piece (independent of its identity)
+ *
+ */
+typedef enum pieceType {
+    PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING,
+
+    // Empty square
+    NO_PIECE_TYPE
+} pieceType;
+
+const int NUM_COLORS = 2;           // white=0, black=1
+const int NUM_PIECE_TYPES = 6;
+const int NUM_SQUARES = 64;
+
+// Square helpers
+inline int makeSquare(int row, int col) { return row * 8 + col; }
+inline int squareRow(int sq) { return sq >> 3; }
+inline int squareCol(int sq) { return sq & 7; }
+inline bitboard squareBB(int sq) { return 1ULL << sq; }
+
+// Bit scan helpers
+inline int lsb(bitboard b) { return __builtin_ctzll(b); }
+inline int msb(bitboard b) { return 63 - __builtin_clzll(b); }
+inline int popCount(bitboard b) { return __builtin_popcountll(b); }
+inline int popLSB(bitboard& b) { int sq = lsb(b); b &= b - 1; return sq; }
+
+// Colour of a piece identity (white=0, black=1, EMPTY=-1)
+int pieceColor(piece p);
+// Kind of a piece identity as set up at the start of the game
+pieceType pieceTypeOf(piece p);
+
+// Precomputed attack tables (filled by initBitboards())
+extern bitboard knightAttacks[NUM_SQUARES];
+extern bitboard kingAttacks[NUM_SQUARES];
+extern bitboard pawnAttacks[NUM_COLORS][NUM_SQUARES];
+
+/**
+ * @brief Magic bitboard lookup data for a sliding piece on one square
+ *
+ */
+typedef struct
+{
+    bitboard mask;          // relevant occupancy (ray squares without the board edge)
+    bitboard magic;         // multiplier hashing the masked occupancy to a table index
+    bitboard* attacks;      // start of this square's slice of the attack table
+    unsigned int shift;     // 64 - number of relevant bits
+} magicEntry;
+
+extern magicEntry bishopMagics[NUM_SQUARES];
+extern magicEntry rookMagics[NUM_SQUARES];
+
+// Squares strictly between two aligned squares, and the full line through them (0 if not aligned)
+extern bitboard betweenBB[NUM_SQUARES][NUM_SQUARES];
+extern bitboard lineBB[NUM_SQUARES][NUM_SQUARES];
+
+// Zobrist keys: random 64-bit numbers xor-ed together to identify a position
+extern uint64_t zobristPieces[NUM_COLORS][NUM_PIECE_TYPES][NUM_SQUARES];
+extern uint64_t zobristCastling[16];
+extern uint64_t zobristEnPassant[8];
+extern uint64_t zobristSide;
+
+// Build the attack tables (including the magic tables), safe to call more than once
+void initBitboards();
+
+// Sliding piece attacks computed by walking the rays (used to build the tables)
+bitboard bishopAttacksRay(int sq, bitboard occupancy);
+bitboard rookAttacksRay(int sq, bitboard occupancy);
+
+// Index of an occupancy in a square's attack table
+inline unsigned int magicIndex(const magicEntry& m, bitboard occupancy)
+{
+#ifdef CHESS_USE_PEXT
+    return (unsigned int)_pext_u64(occupancy, m.mask);
+#else
+    return (unsigned int)(((occupancy & m.mask) * m.magic) >> m.shift);
+#endif
+}
+
+// Sliding piece attacks for the given occupancy (one table lookup)
+inline bitboard bishopAttacks(int sq, bitboard occupancy) { return bishopMagics[sq].attacks[magicIndex(bishopMagics[sq], occupancy)]; }
+inline bitboard rookAttacks(int sq, bitboard occupancy) { return rookMagics[sq].attacks[magicIndex(rookMagics[sq], occupancy)]; }
+inline bitboard queenAttacks(int sq, bitboard occupancy) { return bishopAttacks(sq, occupancy) | rookAttacks(sq, occupancy); }
+
+
+// Castling rights bits
+const int WHITE_OO = 1, WHITE_OOO = 2, BLACK_OO = 4, BLACK_OOO = 8;
+const int NO_SQUARE = -1;
+
+/**
+ * @brief A move packed in 16 bits: from square (bits 0-5), to square (bits 6-11)
+ *        and move flags (bits 12-15)
+ *
+ */
+typedef uint16_t chessMove;
+
+typedef enum moveFlag {
+    QUIET_MOVE = 0,
+    DOUBLE_PUSH = 1,
+    KING_CASTLE = 2,
+    QUEEN_CASTLE = 3,
+    CAPTURE = 4,
+    EN_PASSANT = 5,
+    PROMOTION = 8,          // + (promoted type - KNIGHT)
+    PROMOTION_CAPTURE = 12  // + (promoted type - KNIGHT)
+} moveFlag;
+
+inline chessMove encodeMove(int from, int to, int flags) { return (chessMove)(from | (to << 6) | (flags << 12)); }
+inline int moveFrom(chessMove m) { return m & 63; }
+inline int moveTo(chessMove m) { return (m >> 6) & 63; }
+inline int moveFlags(chessMove m) { return m >> 12; }
+inline bool isCapture(chessMove m) { return (moveFlags(m) & CAPTURE) != 0; }
+inline bool isPromotion(chessMove m) { return (moveFlags(m) & PROMOTION) != 0; }
+inline pieceType promotionType(chessMove m) { return (pieceType)(KNIGHT + (moveFlags(m) & 3)); }
+// UCI notation of a move ("e2e4", "e7e8q")
+std::string moveToUCI(chessMove m);
+
+// More than the maximum number of legal moves in any chess position (218)
+const int MAX_MOVES = 256;
+
+/**
+ * @brief Fixed capacity move buffer, lives on the stack (no heap allocation)
+ *
+ */
+typedef struct moveList
+{
+    chessMove moves[MAX_MOVES];
+    int count;
+
+    void clear() { count = 0; }
+    void add(chessMove m) { moves[count++] = m; }
+    const chessMove* begin() const { return moves; }
+    const chessMove* end() const { return moves + count; }
+} moveList;
+
+// Plies kept for takebacks (the oldest are dropped beyond this)
+const int MAX_GAME_PLY = 1024;
+// Largest halfmove clock loadFEN accepts: undoRecord keeps the clock in 16 bits,
+// this leaves room for a game's worth of plies on top of it
+const int MAX_FEN_HALFMOVE_CLOCK = INT16_MAX - MAX_GAME_PLY;
+
+/**
+ * @brief State a move destroys, enough to take it back
+ *
+ */
+typedef struct
+{
+    uint64_t key;               // Zobrist key before the move
+    piece captured;             // captured identity (EMPTY if none)
+    pieceType capturedType;     // type of the captured piece
+    int8_t castlingRights;      // castling rights before the move
+    int8_t epSquare;            // en passant square before the move
+    int16_t halfmoveClock;      // halfmove clock before the move
+} undoRecord;
+
+
+/**
+ * @class chessPosition
+ * @brief Piece placement stored as one bitboard per piece type and colour,
+ *        plus occupancy boards and a square -> piece identity mailbox so the
+ *        tModelMap entries can still be looked up by their piece enum.
+ *
+ */
+class chessPosition {
+public:
+    bitboard pieces[NUM_COLORS][NUM_PIECE_TYPES];   // squares of each piece type per colour
+    bitboard colors[NUM_COLORS];                    // all squares occupied by a colour
+    bitboard occupied;                              // all occupied squares
+    piece squares[NUM_SQUARES];                     // piece identity on each square
+    pieceType types[NUM_SQUARES];                   // piece type on each square
+
+    int sideToMove;                                 // white=0, black=1
+    int castlingRights;                             // WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO
+    int epSquare;                                   // en passant target square (NO_SQUARE if none)
+    int halfmoveClock;                              // plies since the last capture or pawn move
+    int fullmoveNumber;                             // starts at 1, incremented after black moves
+    uint64_t key;                                   // Zobrist key, updated with every change above
+
+    // Constructor function
+    chessPosition();
+    // Remove all the pieces and reset the game state
+    void clear();
+    // Place a piece identity of the given type on an empty square
+    void putPiece(piece p, pieceType t, int sq);
+    // Remove the piece on a square, returns the removed identity (EMPTY if none)
+    piece removePiece(int sq);
+    // Relocate the piece on "from" to the empty square "to"
+    void movePiece(int from, int to);
+    // Square of the king of the given colour
+    int kingSquare(int color) const { return lsb(pieces[color][KING]); }
+    // All pieces (both colours) attacking a square for the given occupancy
+    bitboard attackersTo(int sq, bitboard occupancy) const;
+    // Is the square attacked by any piece of the colour "byColor"?
+    bool isSquareAttacked(int sq, int byColor, bitboard occupancy) const;
+    // Is the king of the given colour in check?
+    bool isInCheck(int color) const { return isSquareAttacked(kingSquare(color), color ^ 1, occupied); }
+    // Play a legal move (from generateLegalMoves) for the side to move, saving what it destroys
+    void makeMove(chessMove m, undoRecord& undo);
+    // Take back the last move played with makeMove
+    void unmakeMove(chessMove m, const undoRecord& undo);
+    // Set up the position from a FEN string, returns false if it can not be parsed or makeMove could not play it
+    bool loadFEN(const std::string& fen);
+    // FEN string of the position
+    std::string toFEN() const;
+    // Zobrist key of the position computed from scratch
+    // (call after setting sideToMove, castlingRights or epSquare by hand)
+    uint64_t computeKey() const;
+};
+
+/**
+ * @brief Preallocated stack of played moves and their undo records
+ *        Works as a ring: past MAX_GAME_PLY the oldest entries are overwritten
+ *
+ */
+typedef struct undoStack
+{
+    chessMove moves[MAX_GAME_PLY];
+    undoRecord records[MAX_GAME_PLY];
+    int top;        // ring index of the next free entry
+    int count;      // number of entries that can be popped
+
+    void clear() { top = count = 0; }
+    bool empty() const { return count == 0; }
+    // Record a move, returns the undo record for makeMove to fill
+    undoRecord& push(chessMove m)
+    {
+        int i = top;
+        moves[i] = m;
+        top = (top + 1) % MAX_GAME_PLY;
+        if (count < MAX_GAME_PLY)
+            count++;
+        return records[i];
+    }
+    // Drop the last move, returns its index for moves[]/records[]
+    int pop()
+    {
+        top = (top + MAX_GAME_PLY - 1) % MAX_GAME_PLY;
+        count--;
+        return top;
+    }
+} undoStack;
+
+// FEN of the standard start position
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// All legal moves of the side to move: pins, check evasions, castling, en passant and promotions
+void generateLegalMoves(const chessPosition& position, moveList& list);
+
+#endif
@@ -28,6 +28,12 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <cstring>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <poll.h>
+#include <fstream>
+#include <algorithm>
 
 #include "ECE_ChessEngine.cpp"
 #include "ECE_ChessHandler.cpp"
@@ -51,12 +57,22 @@ using namespace glm;
 // Lab3 specific chess class
 #include "chessComponent.h"
 #include "chessCommon.h"
+#include "chessAnimation.h"
+#include "spscQueue.h"
+#include "chessHeadless.h"
+#include "frameProfiler.h"
+#include "frustumCull.h"
+#include "meshCache.h"
+#include "assetBundle.h"
+#include "assetLoader.h"
+#include "textureCache.h"
+#include "uciReader.h"
 
 /**
  * @brief Enum for different typr of commands
  * 
  */
-typedef enum commands {MOVE, CAMERA, LIGHT, POWER, QUIT, INVALID} commands;
+typedef enum commands {MOVE, UNDO, FEN, CAMERA, LIGHT, POWER, SPEED, SKIP, QUIT, INVALID} commands;
 
 
 /**
@@ -69,57 +85,147 @@ typedef struct action {
     std::vector<float> cameraAngle;
     std::vector<float> lightAngle;
     float power;
+    float speed;    // animation speed factor
 } action;
 
 
+// Longest sleep of the render loop when nothing changes (seconds)
+const double IDLE_WAIT_SECONDS = 0.5;
+// Time between two loading frames while the assets load (seconds)
+const double LOADING_FRAME_SECONDS = 1.0 / 60.0;
+
+// Parsed commands handed from the input thread to the render loop
+typedef spscQueue<action, 64> commandQueue;
+
+/**
+ * @brief Frustum culling state: the pieces of the frame and their world bounds
+ * 
+ */
+typedef struct {
+    boxBatch boxes;                             // world bounds of the alive pieces
+    std::vector<chessComponent*> components;    // mesh of each box
+    std::vector<const glm::mat4*> models;       // cached model matrix of each box
+    long submitted;                             // pieces drawn, all frames
+    long culled;                                // pieces skipped, all frames
+} cullStateT;
+
+/**
+ * @brief GL objects shared by every frame
+ * 
+ */
+typedef struct {
+    GLuint frameDataBuffer;                 // FrameData uniform buffer
+    GLuint textureID;                       // "myTextureSampler" uniform
+    chessComponent* meshTable[NUM_MESHES];  // component drawn for each mesh handle
+    cullStateT* culling;
+} sceneT;
+
 // Functions for parsing the command
 std::string trim(const std::string& str);
 void parseCommand(const std::string& input, action* a);
+void readCommands(commandQueue* queue, action parsed, std::atomic<bool>* running);
+// Meshes and textures read in parallel and uploaded, with a loading frame in the window
+bool loadAssets(std::vector<chessComponent>& components, textureCache& textures, bool showLoading);
+// Rendering shared by the window and the headless mode
+void computeFrameData(const action& a, frameDataT& frameData);
+void drawScene(const sceneT& scene, const frameDataT& frameData, tModelMap& modelMap);
+int runScript(const char* scriptPath, const std::string& outDir, const sceneT& scene, headlessContextT& offscreen,
+              frameProfiler& profiler, action a);
 
 
-int main( void )
+int main(int argc, char* argv[])
 {
-    // Initialize GLFW
-    if( !glfwInit() )
+    // Options: --headless <script> renders the scripted commands offscreen instead of opening a window
+    const char* scriptPath = NULL;
+    std::string outDir = ".";
+    int width = 1024;
+    int height = 768;
+    // --profile <file> writes the frame times (.json: Chrome trace, otherwise CSV)
+    std::string profilePath;
+    for (int i = 1; i < argc; i++)
     {
-        fprintf( stderr, "Failed to initialize GLFW\n" );
-        getchar();
-        return -1;
+        if (!strcmp(argv[i], "--headless") && i + 1 < argc)     scriptPath = argv[++i];
+        else if (!strcmp(argv[i], "--profile") && i + 1 < argc) profilePath = argv[++i];
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc)     outDir = argv[++i];
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) i++;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--headless <script> [--out <dir>] [--size <W>x<H>]] [--profile <file.csv|file.json>]\n", argv[0]);
+            return -1;
+        }
     }
+    bool headless = (scriptPath != NULL);
+    headlessContextT offscreen = {};
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (headless)
+    {
+        // No window and no display server: a surfaceless context drawing into a framebuffer object
+        if (!createHeadlessContext(offscreen))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        // Initialize GLFW
+        if( !glfwInit() )
+        {
+            fprintf( stderr, "Failed to initialize GLFW\n" );
+            getchar();
+            return -1;
+        }
 
-    // Open a window and create its OpenGL context
-    window = glfwCreateWindow( 1024, 768, "Game Of Chess 3D", NULL, NULL);
-    if( window == NULL ){
-        fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version.\n" );
-        getchar();
-        glfwTerminate();
-        return -1;
+        glfwWindowHint(GLFW_SAMPLES, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        // Open a window and create its OpenGL context
+        window = glfwCreateWindow( 1024, 768, "Game Of Chess 3D", NULL, NULL);
+        if( window == NULL ){
+            fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version.\n" );
+            getchar();
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
     }
-    glfwMakeContextCurrent(window);
 
     // Initialize GLEW
     glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK) {
+    GLenum glewStatus = glewInit();
+    // GLEW also looks for a GLX display, which a surfaceless context does not have: there only the GL entry points matter
+    if (glewStatus != GLEW_OK && !(headless && glGenFramebuffers != NULL)) {
         fprintf(stderr, "Failed to initialize GLEW\n");
+        if (headless) {
+            destroyHeadlessContext(offscreen);
+            return -1;
+        }
         getchar();
         glfwTerminate();
         return -1;
     }
 
-    // Ensure we can capture the escape key being pressed below
-    glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
-    // Hide the mouse and enable unlimited movement
-    // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    
-    // Set the mouse at the center of the screen
-    glfwPollEvents();
-    glfwSetCursorPos(window, 1024/2, 768/2);
+    if (headless)
+    {
+        if (!createOffscreenFramebuffer(offscreen, width, height))
+        {
+            destroyHeadlessContext(offscreen);
+            return -1;
+        }
+    }
+    else
+    {
+        // Ensure we can capture the escape key being pressed below
+        glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+        // Hide the mouse and enable unlimited movement
+        // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        
+        // Set the mouse at the center of the screen
+        glfwPollEvents();
+        glfwSetCursorPos(window, 1024/2, 768/2);
+    }
 
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
@@ -132,241 +238,336 @@ int main( void )
     // Cull triangles which normal is not towards the camera
     glEnable(GL_CULL_FACE);
 
-    GLuint VertexArrayID;
-    glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    // Each chess component owns its VAO (set up in setupGLBuffers)
 
     // Create and compile our GLSL program from the shaders
     GLuint programID = LoadShaders( "StandardShading.vertexshader", "StandardShading.fragmentshader" );
 
-    // Get a handle for our "MVP" uniform
-    GLuint MatrixID = glGetUniformLocation(programID, "MVP");
-    GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
-    GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
+    // Per-frame data (view, projection and light) lives in one uniform buffer,
+    // M comes per instance from a vertex attribute
+    sceneT scene = {};
+    cullStateT culling = {};
+    scene.culling = &culling;
+    GLuint frameDataIndex = glGetUniformBlockIndex(programID, "FrameData");
+    glUniformBlockBinding(programID, frameDataIndex, FRAME_DATA_BINDING);
+    glGenBuffers(1, &scene.frameDataBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, scene.frameDataBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frameDataT), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, scene.frameDataBuffer);
+    frameDataT frameData = {};
 
     // Get a handle for our "myTextureSampler" uniform
-    GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
-
-    // Get a handle for our "lightToggleSwitch" uniform
-    GLuint LightSwitchID = glGetUniformLocation(programID, "lightSwitch");
+    scene.textureID = glGetUniformLocation(programID, "myTextureSampler");
 
+    // Textures shared by the components using the same file (declared first, it outlives them)
+    textureCache textures;
     // Create a vector of chess components class
     // Each component is fully self sufficient
     std::vector<chessComponent> gchessComponents;
 
-    // Load the OBJ files
-    bool cBoard = loadAssImpLab3("Lab3/Stone_Chess_Board/12951_Stone_Chess_Board_v1_L3.obj", gchessComponents);
-    bool cComps = loadAssImpLab3("Lab3/Chess/chess-mod.obj", gchessComponents);
-
+    // Load the OBJ files and the textures, and put them in VBOs and textures (One time activity)
     // Proceed iff OBJ loading is successful
-    if (!cBoard || !cComps)
+    if (!loadAssets(gchessComponents, textures, !headless))
     {
         // Quit the program (Failed OBJ loading)
         std::cout << "Program failed due to OBJ loading failure, please CHECK!" << std::endl;
+        if (headless)
+        {
+            glDeleteBuffers(1, &scene.frameDataBuffer);
+            glDeleteProgram(programID);
+            gchessComponents.clear();
+            destroyHeadlessContext(offscreen);
+        }
         return -1;
     }
 
-    // Load it into a VBO (One time activity)
-    // Run through all the components for rendering
-    for (auto cit = gchessComponents.begin(); cit != gchessComponents.end(); cit++)
+    // Resolve the mesh names once: meshTable[meshID] is the component drawn for that handle
+    chessComponent** meshTable = scene.meshTable;
+    for (auto& component : gchessComponents)
     {
-        // Setup VBO buffers
-        cit->setupGLBuffers();
-        // Setup Texture
-        cit->setupTextureBuffers();
+        for (int m = 0; m < NUM_MESHES; m++)
+        {
+            if (component.getComponentID() == meshNames[m])
+            {
+                meshTable[m] = &component;
+            }
+        }
+    }
+    for (int m = 0; m < NUM_MESHES; m++)
+    {
+        if (meshTable[m] == nullptr)
+        {
+            std::cout << "Mesh " << meshNames[m] << " not found in the OBJ files!" << std::endl;
+        }
     }
 
     // Use our shader (Not changing the shader per chess component)
     glUseProgram(programID);
 
-    // Get a handle for our "LightPosition" uniform
-    GLuint LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
-
-    // Get a handle for our "LightPower" uniform
-    GLuint lightPowerLocation = glGetUniformLocation(programID, "LightPower");
-
-    // For speed computation
-    double lastTime = glfwGetTime();
-    int nbFrames = 0;
-    
-
 
     // Initialize the start up camera and light
     action a;
     a.cameraAngle = {10.0f, 270.0f, 40.0f};
     a.lightAngle = {0.0f, 0.0f, 15.0f};
     a.power = 400.0f;
+    a.speed = 1.0f;
 
+    // Frame timing: always on in the headless mode, otherwise only with --profile
+    frameProfiler profiler(profilePath, headless);
+
+    // Scripted run: no engine, no input thread
+    if (headless)
+    {
+        int status = runScript(scriptPath, outDir, scene, offscreen, profiler, a);
+        if (!profiler.finish())
+            status = -1;
+        glDeleteBuffers(1, &scene.frameDataBuffer);
+        glDeleteProgram(programID);
+        // Free the GL objects of the components while the context is still current
+        gchessComponents.clear();
+        destroyHeadlessContext(offscreen);
+        return status;
+    }
     
     // Initialize the chess engine
     ECE_ChessEngine komodo;
+    // Wake the render loop when the reply arrives
+    komodo.onReply = []() { glfwPostEmptyEvent(); };
     komodo.InitializeEngine();
     komodo.setOptions("Minimal Reporting value 5");
 
 
     // Setup the Chess board locations
     chessModel cModel;
-    cModel.isPieceMoving = false;
-    cModel.startTime = std::chrono::time_point<std::chrono::high_resolution_clock>::min();
     ECE_ChessHandler game;
     game.setupChessBoard(cModel.cTModelMap);
 
-    std::string input;
-    std::string command;
+    // Commands are read on their own thread so the window keeps rendering while the user types
+    commandQueue commands;
+    std::atomic<bool> inputRunning(true);
+    std::thread inputThread(readCommands, &commands, a, &inputRunning);
+    // Game commands wait here until it is the user's turn and the board is still
+    std::deque<action> pendingCommands;
+
+    // Render on demand: a frame is drawn only when something on screen changed
+    bool frameDirty = true;                 // board changes and window events
+    frameDataT lastFrameData = {};          // camera and light of the last frame drawn
+    long activeFrames = 0;                  // frames drawn
+    long idleFrames = 0;                    // loop passes that slept instead
+    glfwSetWindowUserPointer(window, &frameDirty);
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) { *(bool*)glfwGetWindowUserPointer(w) = true; });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int, int) { *(bool*)glfwGetWindowUserPointer(w) = true; });
+
+    // Wall time of the last loop pass, for the animations
+    double lastTime = glfwGetTime();
     
     do{
-        // Measure speed
+        profiler.beginFrame();
+        bool drawn = false;
+
+        // View and light state of this frame
+        {
+            profileScope zone(profiler, ZONE_UPDATE);
+            computeFrameData(a, frameData);
+        }
+
+        // Advance the pieces that are moving (fixed timestep inside the pool)
         double currentTime = glfwGetTime();
-        nbFrames++;
+        double frameSeconds = currentTime - lastTime;
+        lastTime = currentTime;
+        if (cModel.animations.busy())
+        {
+            profileScope zone(profiler, ZONE_ANIMATION);
+            // Every animation step is drawn, including the last one
+            frameDirty = true;
+            cModel.animations.update(frameSeconds, cModel.cTModelMap);
+        }
 
-        // If last prinf() was more than 1sec ago
-        if (currentTime - lastTime >= 1.0) 
-        { // If last prinf() was more than 1sec ago
-            // printf and reset
-            // printf("%f ms/frame\n", 1000.0 / double(nbFrames));
-            nbFrames = 0;
-            lastTime += 1.0;
+
+        // Camera or light changes show up as a change of the frame data
+        if (!frameDirty && memcmp(&frameData, &lastFrameData, sizeof(frameDataT)) == 0)
+        {
+            // Nothing changed: sleep until an event arrives (the input thread and the engine post one)
+            idleFrames++;
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 2)
+            glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+#else
+            glfwWaitEvents();
+#endif
         }
+        else
+        {
+            activeFrames++;
+            drawn = true;
+            frameDirty = false;
+            lastFrameData = frameData;
 
-        // Clear the screen
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            {
+                profileScope zone(profiler, ZONE_DRAW);
+                profiler.beginGPU();
+                drawScene(scene, frameData, cModel.cTModelMap);
+                profiler.endGPU();
+            }
 
-        // Compute the VP matrix from keyboard and mouse input
-        computeMatricesFromInputsFinal(a.cameraAngle[0], a.cameraAngle[1], a.cameraAngle[2]);
-        glm::mat4 ProjectionMatrix = getProjectionMatrix();
-        glm::mat4 ViewMatrix = getViewMatrix();
+            // Swap buffers
+            profileScope zone(profiler, ZONE_SWAP);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
 
-        // Get light switch State (It's a toggle!)
-        bool lightSwitch = getLightSwitch();
-        // Pass it to Fragment Shader
-        glUniform1i(LightSwitchID, static_cast<int>(lightSwitch));
 
-        // Update the position of any piece that is moving
-        if (cModel.isPieceMoving)
+        // View commands take effect at once, game commands wait for their turn
+        profiler.beginZone(ZONE_UPDATE);
+        action received;
+        bool quit = false;
+        while (commands.pop(received))
         {
-            // Get the elapsed timesince start of animation
-            auto currentTime = std::chrono::high_resolution_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - cModel.startTime);
-
-            if (elapsed < std::chrono::milliseconds(2000))
+            if (received.type == QUIT) 
+            {
+                // The engine is told to quit when komodo goes out of scope
+                quit = true;
+            }
+            else if (received.type == CAMERA) 
             {
-                // Calculate interpolation factor 
-                float t = std::fmin(1.0f, (float)elapsed.count() / 2000.0);
-
-                // Interpolate position 
-                cModel.cTModelMap[cModel.pieceMoving].tPos.x = cModel.startPos.x + t * (cModel.endPos.x - cModel.startPos.x);
-                cModel.cTModelMap[cModel.pieceMoving].tPos.y = cModel.startPos.y + t * (cModel.endPos.y - cModel.startPos.y);
-                // Make the knight jump
-                if(cModel.pieceMoving == WHITE_KNIGHT_1 || cModel.pieceMoving == WHITE_KNIGHT_2 || cModel.pieceMoving == BLACK_KNIGHT_1 || cModel.pieceMoving == BLACK_KNIGHT_2)
-                    cModel.cTModelMap[cModel.pieceMoving].tPos.z = 5.f;
+                a.cameraAngle = received.cameraAngle;
+            }
+            else if (received.type == LIGHT) 
+            {
+                a.lightAngle = received.lightAngle;
+            }
+            else if (received.type == POWER) 
+            {
+                a.power = received.power;
+            }
+            else if (received.type == SPEED) 
+            {
+                // Replays can run compressed, up to 100 times faster
+                cModel.animations.setSpeed(received.speed);
+            }
+            else if (received.type == SKIP) 
+            {
+                // Land every moving piece now
+                cModel.animations.finishAll(cModel.cTModelMap);
+                frameDirty = true;
             }
             else 
             {
-                // Animation finished, set final position
-                cModel.cTModelMap[cModel.pieceMoving].tPos = cModel.endPos;
-                cModel.isPieceMoving = false;
-                cModel.startTime = std::chrono::time_point<std::chrono::high_resolution_clock>::min();
+                pendingCommands.push_back(received);
             }
         }
-
-        // Run through all the entries in cTModelMap for rendering
-        for (auto& mapEntry : cModel.cTModelMap)
+        profiler.endZone(ZONE_UPDATE);
+        if (quit) 
         {
-            tPosition& cTPosition = mapEntry.second;
-            if (cTPosition.isAlive) 
-            {
-                // Find a matching component in gchessComponents based on meshName
-                auto cit = std::find_if(gchessComponents.begin(), gchessComponents.end(),[&](auto& component) { return component.getComponentID() == cTPosition.meshName; });
-
-                // Ensure the component exists in gchessComponents before rendering
-                if (cit != gchessComponents.end())
-                {
-                    // Pass it for Model matrix generation
-                    glm::mat4 ModelMatrix = cit->genModelMatrix(cTPosition);
-
-                    // Generate the MVP matrix
-                    glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-
-                    // Send our transformation to the currently bound shader,
-                    // in the "MVP" uniform
-                    glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-                    glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-                    glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-
-                    // Update the light angle and power
-                    // Convert to Cartesian co-ordinate system
-                    float lightX = a.lightAngle[2] * sin(glm::radians(a.lightAngle[0])) * cos(glm::radians(a.lightAngle[1]));
-                    float lightY = a.lightAngle[2] * sin(glm::radians(a.lightAngle[0])) * sin(glm::radians(a.lightAngle[1]));
-                    float lightZ = a.lightAngle[2] * cos(glm::radians(a.lightAngle[0]));
-                    glUniform3f(LightID, lightX, lightY, lightZ);
-                    glUniform1f(lightPowerLocation, a.power);
-
-                    // Bind our texture 
-                    cit->setupTexture(TextureID);
-
-                    // Render buffers
-                    cit->renderMesh();
-                }
-            }
+            break;
         }
-        // Swap buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-
 
         // if animation is complete, go for the next move
-        if (!cModel.isPieceMoving && !game.inCheckMate)
+        // Pieces may still be moving: the next move does not wait for them
+        if (!game.inCheckMate && !game.inStaleMate)
         {
             if (game.user_turn % 2 == 0) 
             {
-                // Get the input from the user
-                std::cout << "Please enter a command: ";
-                std::getline(std::cin, input);
-
-                // Parse the input into the action struct
-                parseCommand(input, &a);
-                if (a.type == QUIT) 
-                {
-                    komodo.sendMove("quit");
-                    break;
-                }
-                else if (a.type == INVALID) 
-                {
-                    continue;
-                }
-                else if (a.type == MOVE) 
+                profileScope zone(profiler, ZONE_UPDATE);
+                if (!pendingCommands.empty()) 
                 {
-                    // Validate and move the piece
-                    game.movePiece(a.move, cModel);
-                    if (game.inCheckMate) {
-                        std::cout << "Checkmate!! You WON. Game over.\nClose the window.";
+                    action cmd = pendingCommands.front();
+                    pendingCommands.pop_front();
+                    // The board (or the console) may change, draw the next frame
+                    frameDirty = true;
+
+                    if (cmd.type == UNDO) 
+                    {
+                        // Take back the engine's reply and the player's move
+                        if (game.played.count >= 2 && game.takeBack(cModel) && game.takeBack(cModel))
+                        {
+                            std::cout << "Took back the last move." << std::endl;
+                        }
+                        else
+                        {
+                            std::cout << "No move to take back!" << std::endl;
+                        }
+                    }
+                    else if (cmd.type == FEN) 
+                    {
+                        // Print the current position, or start over from the given one
+                        if (cmd.move.empty())
+                        {
+                            std::cout << game.toFEN() << std::endl;
+                        }
+                        else
+                        {
+                            // The board is rebuilt: land the moving pieces first
+                            cModel.animations.finishAll(cModel.cTModelMap);
+                            if (game.loadFEN(cmd.move, cModel.cTModelMap))
+                            {
+                                std::cout << "Position loaded." << std::endl;
+                            }
+                            else
+                            {
+                                std::cout << "Invalid FEN!" << std::endl;
+                            }
+                        }
+                    }
+                    else if (cmd.type == MOVE) 
+                    {
+                        // Validate and move the piece
+                        game.movePiece(cmd.move, cModel);
+                        if (game.inCheckMate) {
+                            std::cout << "Checkmate!! You WON. Game over.\nClose the window.";
+                        }
+                        else if (game.inStaleMate) {
+                            std::cout << "Stalemate!! It's a draw. Game over.\nClose the window.";
+                        }
                     }
                 }
             }
             else {    
-                komodo.sendMove(game.moveHistory);
+                profileScope zone(profiler, ZONE_ENGINE);
+                // Start the search once, then keep rendering until the reply arrives
+                if (!komodo.isThinking())
+                {
+                    komodo.sendMove(game.toFEN());
+                }
 
-                // Read Komodo's output
+                // Read Komodo's output (does not block)
                 std::string komodoOutput;
                 if(komodo.getResponseMove(komodoOutput))
                 {
                     // Validate and move the piece
                     game.movePiece(komodoOutput, cModel);
+                    frameDirty = true;
                     if (game.inCheckMate) {
                         std::cout << "Checkmate!! You LOST. Game over.\nClose the window.\n";
                         //  break;
                     }
+                    else if (game.inStaleMate) {
+                        std::cout << "Stalemate!! It's a draw. Game over.\nClose the window.\n";
+                    }
                 }
             } 
         }
+        profiler.endFrame(drawn);
     // Check if the ESC key was pressed or the window was closed
     }while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
                glfwWindowShouldClose(window) == 0 );
     
 
+    // Write the profile while the context is still current
+    profiler.finish();
+
+    // How often the loop could sleep instead of drawing
+    long loopPasses = activeFrames + idleFrames;
+    printf("Frames drawn: %ld, idle waits: %ld (%.1f%% idle)\n", activeFrames, idleFrames,
+           loopPasses > 0 ? 100.0 * idleFrames / loopPasses : 0.0);
+    printf("Pieces drawn: %ld, culled: %ld\n", culling.submitted, culling.culled);
+
+    // Stop the input thread (it checks the flag between lines)
+    inputRunning = false;
+    inputThread.join();
+
     // Cleanup VBO, Texture (Done in class destructor) and shader 
+    glDeleteBuffers(1, &scene.frameDataBuffer);
     glDeleteProgram(programID);
-    glDeleteVertexArrays(1, &VertexArrayID);
 
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
@@ -376,6 +577,367 @@ int main( void )
 
 
 
+/**
+ * @brief Load the scene on the asset loader threads. This (GL) thread uploads the
+ *        textures as they are read and the meshes once every OBJ file is in, and
+ *        keeps the window alive with a loading frame meanwhile.
+ * 
+ * @param components    the components of all the OBJ files are appended, uploaded
+ * @param textures      the components hold their textures from it
+ * @param showLoading   draw loading frames in the window
+ * @return true if every OBJ file was loaded
+ */
+bool loadAssets(std::vector<chessComponent>& components, textureCache& textures, bool showLoading)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    double uploadMs = 0.0;
+
+    // The bundle and the caches stay mapped until the meshes are uploaded
+    assetBundle bundle;
+    if (bundle.open(ASSET_BUNDLE_PATH))
+    {
+        std::cout << "Assets from " << ASSET_BUNDLE_PATH << std::endl;
+    }
+    meshCache caches[NUM_OBJ_FILES];
+    std::vector<chessComponent> loaded[NUM_OBJ_FILES];
+    bool objLoaded = true;
+
+    unsigned int threads = std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_LOADER_THREADS));
+    {
+        assetLoader loader(bundle, caches, threads);
+        loader.start();
+        while (!loader.done())
+        {
+            loadResultT result;
+            if (!loader.next(result, LOADING_FRAME_SECONDS))
+            {
+                if (showLoading)
+                {
+                    // Loading frame: the background, with the progress in the title
+                    int completed, submitted;
+                    loader.progress(completed, submitted);
+                    std::string title = "Game Of Chess 3D - loading " + std::to_string(completed) + "/" + std::to_string(submitted);
+                    glfwSetWindowTitle(window, title.c_str());
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    glfwSwapBuffers(window);
+                    glfwPollEvents();
+                }
+                continue;
+            }
+
+            if (result.type == LOADED_MESHES)
+            {
+                objLoaded = objLoaded && result.ok;
+                loaded[result.file] = std::move(result.components);
+            }
+            else if (result.ok)
+            {
+                auto uploadStart = std::chrono::steady_clock::now();
+                // Uploaded once per file, from the mapped file, the components share it
+                textures.add(result.path, uploadMappedBMP(result.bmp), result.bmp.width, result.bmp.height,
+                             textureCache::fullMipLevels(result.bmp.width, result.bmp.height));
+                unmapBMP(result.bmp);
+                uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+            }
+        }
+    }
+    if (showLoading)
+    {
+        glfwSetWindowTitle(window, "Game Of Chess 3D");
+    }
+    if (!objLoaded)
+    {
+        textures.purgeUnused();
+        return false;
+    }
+
+    // Components in file order, whichever file was read first, and in their final place before the upload
+    size_t total = components.size();
+    for (const auto& file : loaded)
+    {
+        total += file.size();
+    }
+    components.reserve(total);
+    size_t first = components.size();
+    for (auto& file : loaded)
+    {
+        for (chessComponent& component : file)
+        {
+            components.push_back(component);
+        }
+        file.clear();
+    }
+
+    auto uploadStart = std::chrono::steady_clock::now();
+    for (size_t c = first; c < components.size(); c++)
+    {
+        chessComponent& component = components[c];
+        // Setup VBO buffers
+        component.setupGLBuffers();
+        // Setup Texture: read by a worker, baked, or (not found) the BMP loader reports it
+        component.setupTextureBuffers(textures, &bundle);
+    }
+    // A texture no component took (its file failed to load) is not kept
+    textures.purgeUnused();
+    uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+
+    std::cout << "Assets ready in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count()
+              << " ms on " << threads << " loader threads (GL upload " << uploadMs << " ms)" << std::endl;
+    textures.report();
+    return true;
+}
+
+/**
+ * @brief Compute the view, projection and light of a frame from the camera and light settings
+ * 
+ * @param a             current camera angle, light angle and power
+ * @param frameData 
+ */
+void computeFrameData(const action& a, frameDataT& frameData)
+{
+    // Compute the VP matrix from keyboard and mouse input
+    computeMatricesFromInputsFinal(a.cameraAngle[0], a.cameraAngle[1], a.cameraAngle[2]);
+    frameData.P = getProjectionMatrix();
+    frameData.V = getViewMatrix();
+    frameData.VP = frameData.P * frameData.V;
+
+    // Get light switch State (It's a toggle!)
+    frameData.lightSwitch = static_cast<int>(getLightSwitch());
+
+    // Update the light angle and power
+    // Convert to Cartesian co-ordinate system
+    float lightX = a.lightAngle[2] * sin(glm::radians(a.lightAngle[0])) * cos(glm::radians(a.lightAngle[1]));
+    float lightY = a.lightAngle[2] * sin(glm::radians(a.lightAngle[0])) * sin(glm::radians(a.lightAngle[1]));
+    float lightZ = a.lightAngle[2] * cos(glm::radians(a.lightAngle[0]));
+    frameData.LightPosition_worldspace = glm::vec3(lightX, lightY, lightZ);
+    frameData.LightPower = a.power;
+}
+
+
+/**
+ * @brief Draw the board and the alive pieces into the bound framebuffer
+ * 
+ * @param scene 
+ * @param frameData 
+ * @param modelMap 
+ */
+void drawScene(const sceneT& scene, const frameDataT& frameData, tModelMap& modelMap)
+{
+    // Clear the screen
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Send the view and light state once per frame in one upload, it is the same for every piece
+    glBindBuffer(GL_UNIFORM_BUFFER, scene.frameDataBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frameDataT), &frameData);
+
+    // Group the alive pieces by mesh (each mesh has its own texture)
+    for (chessComponent* component : scene.meshTable)
+    {
+        if (component != nullptr)
+        {
+            component->clearInstances();
+        }
+    }
+    cullStateT& cull = *scene.culling;
+    cull.boxes.clear();
+    cull.components.clear();
+    cull.models.clear();
+    for (auto& mapEntry : modelMap)
+    {
+        tPosition& cTPosition = mapEntry.second;
+        if (cTPosition.isAlive) 
+        {
+            // Component resolved at load time (no search or string compare per frame)
+            chessComponent* cit = scene.meshTable[cTPosition.mesh];
+
+            // Ensure the component exists in gchessComponents before rendering
+            if (cit != nullptr)
+            {
+                // Pass it for Model matrix generation (cached with its bounds until the piece moves)
+                const glm::mat4& model = cit->genModelMatrix(cTPosition);
+                cull.boxes.add(cTPosition.boundsCenter, cTPosition.boundsExtent);
+                cull.components.push_back(cit);
+                cull.models.push_back(&model);
+            }
+        }
+    }
+
+    // Only the pieces at least partly inside the view frustum are submitted
+    size_t visible = cullBoxes(extractFrustum(frameData.VP), cull.boxes);
+    cull.submitted += visible;
+    cull.culled += cull.boxes.count - visible;
+    for (size_t i = 0; i < cull.boxes.count; i++)
+    {
+        if (cull.boxes.visible[i])
+        {
+            cull.components[i]->addInstance(*cull.models[i]);
+        }
+    }
+
+    // One draw call per mesh for all its pieces
+    for (chessComponent* component : scene.meshTable)
+    {
+        if (component != nullptr && component->instanceCount() > 0)
+        {
+            // Bind our texture 
+            component->setupTexture(scene.textureID);
+
+            // Render buffers
+            component->renderInstances();
+        }
+    }
+}
+
+
+/**
+ * @brief Headless mode: plays a script on the offscreen framebuffer and times the frames drawn.
+ *        Script lines are the interactive commands (move, undo, fen, camera, light, power, quit)
+ *        plus "frame [file]" to draw a frame and write it as PPM (frame_NNNN.ppm by default)
+ *        and "bench <n>" to draw n frames without writing them. Lines starting with '#' are comments.
+ *        There is no engine: moves are played for both sides and snap to their square.
+ *        The frames are timed by the profiler, which the caller finishes.
+ * 
+ * @param scriptPath 
+ * @param outDir        directory of the frames written
+ * @param scene 
+ * @param offscreen 
+ * @param profiler
+ * @param a             start up camera and light
+ * @return int          0, or -1 on the first failing line
+ */
+int runScript(const char* scriptPath, const std::string& outDir, const sceneT& scene, headlessContextT& offscreen,
+              frameProfiler& profiler, action a)
+{
+    std::ifstream script(scriptPath);
+    if (!script)
+    {
+        std::cerr << "Cannot open script " << scriptPath << std::endl;
+        return -1;
+    }
+
+    // Setup the Chess board locations
+    chessModel cModel;
+    ECE_ChessHandler game;
+    game.setupChessBoard(cModel.cTModelMap);
+
+    frameDataT frameData = {};
+
+    int frameNumber = 0;
+    int lineNumber = 0;
+    int status = 0;
+    bool quit = false;
+    std::string line;
+    while (status == 0 && !quit && std::getline(script, line))
+    {
+        lineNumber++;
+        std::string command = trim(line);
+        if (command.empty() || command[0] == '#')
+        {
+            continue;
+        }
+
+        size_t spacePos = command.find(' ');
+        std::string commandType = command.substr(0, spacePos);
+        std::string arguments = (spacePos != std::string::npos) ? trim(command.substr(spacePos + 1)) : "";
+
+        if (commandType == "frame" || commandType == "bench")
+        {
+            int count = (commandType == "bench") ? atoi(arguments.c_str()) : 1;
+            if (count <= 0)
+            {
+                std::cerr << scriptPath << ":" << lineNumber << ": invalid frame count" << std::endl;
+                status = -1;
+                break;
+            }
+
+            std::string path;
+            if (commandType == "frame")
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "frame_%04d.ppm", frameNumber);
+                path = outDir + "/" + (arguments.empty() ? std::string(name) : arguments);
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                profiler.beginFrame();
+                {
+                    profileScope zone(profiler, ZONE_UPDATE);
+                    computeFrameData(a, frameData);
+                }
+                {
+                    profileScope zone(profiler, ZONE_DRAW);
+                    profiler.beginGPU();
+                    drawScene(scene, frameData, cModel.cTModelMap);
+                    profiler.endGPU();
+                }
+                profiler.endFrame(true);
+                frameNumber++;
+            }
+
+            if (!path.empty() && !writeFramePPM(offscreen, path))
+            {
+                status = -1;
+            }
+            continue;
+        }
+
+        action parsed = a;
+        parseCommand(command, &parsed);
+        if (parsed.type == INVALID)
+        {
+            std::cerr << scriptPath << ":" << lineNumber << ": " << command << std::endl;
+            status = -1;
+        }
+        else if (parsed.type == QUIT)
+        {
+            quit = true;
+        }
+        else if (parsed.type == CAMERA || parsed.type == LIGHT || parsed.type == POWER)
+        {
+            a = parsed;
+        }
+        else if (parsed.type == UNDO)
+        {
+            // A single ply, both sides are played by the script
+            if (!game.takeBack(cModel))
+            {
+                std::cerr << scriptPath << ":" << lineNumber << ": no move to take back" << std::endl;
+                status = -1;
+            }
+        }
+        else if (parsed.type == FEN)
+        {
+            if (parsed.move.empty())
+            {
+                std::cout << game.toFEN() << std::endl;
+            }
+            else if (!game.loadFEN(parsed.move, cModel.cTModelMap))
+            {
+                std::cerr << scriptPath << ":" << lineNumber << ": invalid FEN" << std::endl;
+                status = -1;
+            }
+        }
+        else if (parsed.type == MOVE)
+        {
+            int turn = game.user_turn;
+            game.movePiece(parsed.move, cModel);
+            if (game.user_turn == turn)
+            {
+                std::cerr << scriptPath << ":" << lineNumber << ": illegal move " << parsed.move << std::endl;
+                status = -1;
+            }
+            // No animation: the pieces land at once
+            cModel.animations.finishAll(cModel.cTModelMap);
+        }
+    }
+
+    printf("Frames drawn: %d\n", frameNumber);
+    printf("Pieces drawn: %ld, culled: %ld\n", scene.culling->submitted, scene.culling->culled);
+    return status;
+}
+
+
 /**
  * @brief Trims leading and trailing whitespace from a string.
  * 
@@ -390,6 +952,78 @@ std::string trim(const std::string& str)
 }
 
 
+/**
+ * @brief Input thread: reads commands from stdin, parses them and pushes them to the render loop
+ *        End of input is treated as the quit command
+ * 
+ * @param queue 
+ * @param parsed    action holding the current camera, light and power settings
+ * @param running   cleared by the render loop on exit
+ */
+void readCommands(commandQueue* queue, action parsed, std::atomic<bool>* running)
+{
+    // stdin is read raw and split here, as the engine pipe: std::getline would keep
+    // pasted or piped lines in the stream buffer, where poll() does not see them
+    uciLineReader lines;
+    std::string_view line;
+    std::string input;
+    bool prompt = true;
+    bool endOfInput = false;
+    while (*running) 
+    {
+        // Every complete line buffered is a command, the last one may end with the input
+        bool haveLine = lines.nextLine(line);
+        if (!haveLine && endOfInput)
+        {
+            line = "quit";
+            haveLine = true;
+        }
+        if (!haveLine)
+        {
+            if (prompt) 
+            {
+                std::cout << "Please enter a command: " << std::flush;
+                prompt = false;
+            }
+
+            // Wait for input with a timeout so the thread notices when the window is closed
+            pollfd stdinPoll = {STDIN_FILENO, POLLIN, 0};
+            if (poll(&stdinPoll, 1, 100) <= 0) 
+            {
+                continue;
+            }
+            if (lines.readFrom(STDIN_FILENO) <= 0)
+            {
+                // End of input (or a read error): finish an unterminated last line, then quit
+                endOfInput = true;
+                if (lines.buffered() > 0)
+                    lines.feed("\n", 1);
+            }
+            continue;
+        }
+        input.assign(line.data(), line.size());
+        prompt = true;
+
+        // Parse the input into the action struct
+        parseCommand(input, &parsed);
+        if (parsed.type == INVALID) 
+        {
+            continue;
+        }
+        while (!queue->push(parsed) && *running) 
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        // Wake the render loop if it is waiting for events
+        glfwPostEmptyEvent();
+        if (parsed.type == QUIT) 
+        {
+            break;
+        }
+    }
+}
+
+
 /**
  * @brief Parses the input and populates the action struct
  * 
@@ -410,9 +1044,10 @@ void parseCommand(const std::string& input, action *a)
 
     if (commandType == "move") 
     {
-        // Ensure move has exactly 4 characters and follows chess format
+        // Ensure move has 4 characters (plus an optional promotion piece) and follows chess format
         a->type = MOVE;
-        if (arguments.length() == 4 &&
+        if ((arguments.length() == 4 || 
+             (arguments.length() == 5 && std::string("qrbn").find(arguments[4]) != std::string::npos)) &&
             arguments[0] >= 'a' && arguments[0] <= 'h' &&
             arguments[1] >= '1' && arguments[1] <= '8' &&
             arguments[2] >= 'a' && arguments[2] <= 'h' &&
@@ -426,6 +1061,16 @@ void parseCommand(const std::string& input, action *a)
             a->type = INVALID;
         }
     } 
+    else if (commandType == "undo") 
+    {
+        a->type = UNDO;
+    }
+    else if (commandType == "fen") 
+    {
+        // No argument prints the current position
+        a->type = FEN;
+        a->move = arguments;
+    }
     else if (commandType == "camera") 
     {
         a->type = CAMERA;
@@ -561,6 +1206,27 @@ void parseCommand(const std::string& input, action *a)
             a->type = INVALID; 
         }
     }
+    else if (commandType == "speed") 
+    {
+        a->type = SPEED;
+        std::istringstream ss(arguments);
+        float value = -1.0f;
+        ss >> value;
+
+        if (value >= tweenPool::MIN_SPEED && value <= tweenPool::MAX_SPEED) 
+        {
+            a->speed = value;
+        }
+        else 
+        {
+            std::cout << "Invalid speed command! (" << tweenPool::MIN_SPEED << " to " << tweenPool::MAX_SPEED << ")" << std::endl;
+            a->type = INVALID; 
+        }
+    }
+    else if (commandType == "skip") 
+    {
+        a->type = SKIP;
+    }
     else if (commandType == "quit") 
     {
         std::cout << "Thanks for playing!" << std::endl;
@@ -0,0 +1,299 @@
+/**
+ * @file frameProfiler.cpp
+ * @brief Frame profiler: CPU zones, GPU timer queries, CSV and Chrome trace output
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "frameProfiler.h"
+#include <algorithm>
+#include <cstdio>
+
+// Zone names in the output files
+static const char* zoneNames[NUM_ZONES] = {"update", "animation", "draw", "swap", "engine"};
+
+
+/**
+ * @brief Construct a new frame profiler
+ *
+ * @param path      output file, empty to only print the summary
+ * @param measure   profile even without an output file
+ */
+frameProfiler::frameProfiler(const std::string& path, bool measure)
+    : outputPath(path), active(!path.empty() || measure), origin(clock::now()), current(), trace(false), nextQuery(0),
+      gpuInFrame(false), firstQuery(true)
+{
+    trace = outputPath.size() >= 5 && outputPath.compare(outputPath.size() - 5, 5, ".json") == 0;
+    for (int q = 0; q < GPU_QUERIES; q++)
+    {
+        queries[q] = 0;
+        queryFrame[q] = QUERY_FREE;
+    }
+}
+
+/**
+ * @brief Milliseconds from the creation of the profiler to a point in time
+ *
+ * @param t
+ * @return double
+ */
+double frameProfiler::sinceOrigin(clock::time_point t) const
+{
+    return std::chrono::duration<double, std::milli>(t - origin).count();
+}
+
+/**
+ * @brief Start timing a loop pass
+ *
+ */
+void frameProfiler::beginFrame()
+{
+    if (!active)
+        return;
+    // Results of earlier frames that are ready by now, without waiting
+    collectQueries(-1);
+    frameStart = clock::now();
+    current = frameRecordT();
+    current.startMs = sinceOrigin(frameStart);
+    current.gpuMs = -1.0;
+    currentEvents.clear();
+    gpuInFrame = false;
+}
+
+/**
+ * @brief Finish the loop pass, keeping it only if a frame was drawn
+ *
+ * @param drawn
+ */
+void frameProfiler::endFrame(bool drawn)
+{
+    if (!active)
+        return;
+    if (drawn)
+    {
+        current.totalMs = sinceOrigin(clock::now()) - current.startMs;
+        frames.push_back(current);
+        if (trace)
+            events.insert(events.end(), currentEvents.begin(), currentEvents.end());
+    }
+    // The query started in this frame now belongs to its record (or to nothing).
+    // The result of the very first query is dropped: llvmpipe answers it with a timestamp, not a duration
+    if (gpuInFrame)
+    {
+        queryFrame[(nextQuery + GPU_QUERIES - 1) % GPU_QUERIES] = (drawn && !firstQuery) ? (long)frames.size() - 1 : QUERY_DROPPED;
+        firstQuery = false;
+    }
+}
+
+/**
+ * @brief Start timing a zone
+ *
+ * @param zone
+ */
+void frameProfiler::beginZone(profileZone zone)
+{
+    if (active)
+        zoneStart[zone] = clock::now();
+}
+
+/**
+ * @brief Stop timing a zone and add its time to the frame
+ *
+ * @param zone
+ */
+void frameProfiler::endZone(profileZone zone)
+{
+    if (!active)
+        return;
+    double startMs = sinceOrigin(zoneStart[zone]);
+    double durationMs = sinceOrigin(clock::now()) - startMs;
+    current.zoneMs[zone] += durationMs;
+    if (trace)
+        currentEvents.push_back({zone, startMs, durationMs});
+}
+
+/**
+ * @brief Start the GPU timer query of the draw pass
+ *
+ */
+void frameProfiler::beginGPU()
+{
+    if (!active)
+        return;
+    if (queries[0] == 0)
+        glGenQueries(GPU_QUERIES, queries);
+    // Only when all slots are still in flight does this wait for the oldest
+    collectQueries(nextQuery);
+    current.gpuStartMs = sinceOrigin(clock::now());
+    glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]);
+}
+
+/**
+ * @brief End the GPU timer query of the draw pass
+ *
+ */
+void frameProfiler::endGPU()
+{
+    if (!active)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    // In use; the frame index is known when the frame ends
+    queryFrame[nextQuery] = QUERY_DROPPED;
+    nextQuery = (nextQuery + 1) % GPU_QUERIES;
+    gpuInFrame = true;
+}
+
+/**
+ * @brief Read the results of the finished queries
+ *
+ * @param wait  slot whose result is needed now, -1 to only take the ready ones
+ */
+void frameProfiler::collectQueries(int wait)
+{
+    for (int q = 0; q < GPU_QUERIES; q++)
+    {
+        if (queryFrame[q] == QUERY_FREE)
+            continue;
+        GLuint available = GL_FALSE;
+        if (q != wait)
+            glGetQueryObjectuiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (q == wait || available)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &nanoseconds);
+            if (queryFrame[q] >= 0)
+                frames[queryFrame[q]].gpuMs = nanoseconds / 1.0e6;
+            queryFrame[q] = QUERY_FREE;
+        }
+    }
+}
+
+/**
+ * @brief One row per drawn frame, times in milliseconds (gpu is -1 if unknown)
+ *
+ * @return true
+ * @return false
+ */
+bool frameProfiler::writeCSV() const
+{
+    FILE* file = fopen(outputPath.c_str(), "w");
+    if (file == NULL)
+        return false;
+    fprintf(file, "frame,start_ms,total_ms");
+    for (int z = 0; z < NUM_ZONES; z++)
+        fprintf(file, ",%s_ms", zoneNames[z]);
+    fprintf(file, ",gpu_ms\n");
+    for (size_t f = 0; f < frames.size(); f++)
+    {
+        const frameRecordT& r = frames[f];
+        fprintf(file, "%zu,%.3f,%.3f", f, r.startMs, r.totalMs);
+        for (int z = 0; z < NUM_ZONES; z++)
+            fprintf(file, ",%.3f", r.zoneMs[z]);
+        fprintf(file, ",%.3f\n", r.gpuMs);
+    }
+    return fclose(file) == 0;
+}
+
+/**
+ * @brief Chrome trace (chrome://tracing, Perfetto): frames and zones on the CPU track,
+ *        the draw pass on a GPU track starting when it was issued
+ *
+ * @return true
+ * @return false
+ */
+bool frameProfiler::writeTrace() const
+{
+    FILE* file = fopen(outputPath.c_str(), "w");
+    if (file == NULL)
+        return false;
+    // Trace times are in microseconds
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for (size_t f = 0; f < frames.size(); f++)
+    {
+        const frameRecordT& r = frames[f];
+        fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"frame\":%zu}}",
+                r.startMs * 1000.0, r.totalMs * 1000.0, f);
+        if (r.gpuMs >= 0.0)
+            fprintf(file, ",\n{\"name\":\"draw\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.1f,\"dur\":%.1f}",
+                    r.gpuStartMs * 1000.0, r.gpuMs * 1000.0);
+    }
+    for (const zoneEventT& e : events)
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+                zoneNames[e.zone], e.startMs * 1000.0, e.durationMs * 1000.0);
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+/**
+ * @brief Percentile of a set of times (nearest rank)
+ *
+ * @param sorted    ascending
+ * @param p         0 to 100
+ * @return double
+ */
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+/**
+ * @brief Print the 50th, 95th and 99th percentiles and the maximum of each zone
+ *
+ */
+void frameProfiler::printSummary() const
+{
+    printf("Profiled frames: %zu\n", frames.size());
+    if (frames.empty())
+        return;
+    printf("%-10s %9s %9s %9s %9s\n", "ms", "p50", "p95", "p99", "max");
+    std::vector<double> times;
+    for (int column = -1; column <= NUM_ZONES; column++)
+    {
+        times.clear();
+        for (const frameRecordT& r : frames)
+        {
+            double t = (column < 0) ? r.totalMs : (column == NUM_ZONES) ? r.gpuMs : r.zoneMs[column];
+            if (t >= 0.0)
+                times.push_back(t);
+        }
+        if (times.empty())
+            continue;
+        std::sort(times.begin(), times.end());
+        const char* name = (column < 0) ? "frame" : (column == NUM_ZONES) ? "gpu" : zoneNames[column];
+        printf("%-10s %9.3f %9.3f %9.3f %9.3f\n", name,
+               percentile(times, 50), percentile(times, 95), percentile(times, 99), times.back());
+    }
+}
+
+/**
+ * @brief Wait for the queries in flight, write the output file (if there is one) and print the summary
+ *
+ * @return true
+ * @return false
+ */
+bool frameProfiler::finish()
+{
+    if (!active)
+        return true;
+    active = false;
+
+    if (queries[0] != 0)
+    {
+        for (int q = 0; q < GPU_QUERIES; q++)
+            collectQueries(q);
+        glDeleteQueries(GPU_QUERIES, queries);
+        queries[0] = 0;
+    }
+
+    bool written = outputPath.empty() || (trace ? writeTrace() : writeCSV());
+    if (!written)
+        fprintf(stderr, "Failed writing the profile to %s\n", outputPath.c_str());
+    printSummary();
+    return written;
+}
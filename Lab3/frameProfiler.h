@@ -0,0 +1,128 @@
+/*
+Objective:
+Per-frame profiler: CPU time of the parts of the render loop and GPU time of
+the draw pass, written as CSV or Chrome trace JSON to look for frame hitches
+*/
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+/**
+ * @brief Timed parts of a frame (a zone can be entered several times per frame, the times add up)
+ *
+ */
+typedef enum profileZone {
+    ZONE_UPDATE,        // frame data and user commands
+    ZONE_ANIMATION,     // moving pieces
+    ZONE_DRAW,          // draw call submission
+    ZONE_SWAP,          // buffer swap and window events
+    ZONE_ENGINE,        // engine search start and reply polling
+    NUM_ZONES
+} profileZone;
+
+/**
+ * @class frameProfiler
+ * @brief Records the zones of every drawn frame. GPU times come from a small ring
+ *        of GL_TIME_ELAPSED queries read back a few frames later, so measuring
+ *        does not stall the pipeline. Everything is kept in memory and written
+ *        by finish(); a profiler made with an empty path only measures when asked to.
+ *
+ */
+class frameProfiler {
+private:
+    typedef std::chrono::steady_clock clock;
+
+    // Queries in flight before the oldest one is waited for
+    static const int GPU_QUERIES = 4;
+    // queryFrame values that are not a frame index
+    static const long QUERY_FREE = -1;
+    static const long QUERY_DROPPED = -2;   // in flight, its frame is not kept
+
+    typedef struct
+    {
+        double startMs;                 // since the profiler was created
+        double totalMs;
+        double zoneMs[NUM_ZONES];
+        double gpuMs;                   // -1 until the query result is read
+        double gpuStartMs;              // CPU time the draw pass was issued
+    } frameRecordT;
+
+    typedef struct
+    {
+        int zone;
+        double startMs;
+        double durationMs;
+    } zoneEventT;
+
+    std::string outputPath;             // empty: the summary is printed, no file written
+    bool active;
+    clock::time_point origin;
+
+    std::vector<frameRecordT> frames;   // drawn frames only
+    frameRecordT current;
+    clock::time_point frameStart;
+    clock::time_point zoneStart[NUM_ZONES];
+
+    // Zone events of the frame in progress, and of all drawn frames (Chrome trace only)
+    bool trace;
+    std::vector<zoneEventT> currentEvents;
+    std::vector<zoneEventT> events;
+
+    GLuint queries[GPU_QUERIES];
+    long queryFrame[GPU_QUERIES];       // frame waiting for each query
+    int nextQuery;
+    bool gpuInFrame;                    // a query was started in the frame in progress
+    bool firstQuery;                    // no query has been issued yet
+
+    double sinceOrigin(clock::time_point t) const;
+    // Read finished queries, waiting for the one in slot 'wait' if it is not free (-1: no wait)
+    void collectQueries(int wait);
+    bool writeCSV() const;
+    bool writeTrace() const;
+    void printSummary() const;
+
+public:
+    // Profiling is on when the path is not empty or 'measure' is set; ".json" writes a Chrome trace, anything else CSV
+    explicit frameProfiler(const std::string& path, bool measure = false);
+
+    bool enabled() const { return active; }
+
+    void beginFrame();
+    // Frames that were not drawn (idle waits) are dropped
+    void endFrame(bool drawn);
+
+    void beginZone(profileZone zone);
+    void endZone(profileZone zone);
+
+    // Around the draw pass, needs the GL context
+    void beginGPU();
+    void endGPU();
+
+    // Wait for the queries in flight, write the file (if any) and print the percentiles
+    // Call while the GL context is current; returns false if the file could not be written
+    bool finish();
+};
+
+/**
+ * @class profileScope
+ * @brief Times a zone from construction to the end of the enclosing block
+ *
+ */
+class profileScope {
+private:
+    frameProfiler& profiler;
+    profileZone zone;
+
+public:
+    profileScope(frameProfiler& p, profileZone z) : profiler(p), zone(z) { profiler.beginZone(zone); }
+    ~profileScope() { profiler.endZone(zone); }
+    profileScope(const profileScope&) = delete;
+    profileScope& operator=(const profileScope&) = delete;
+};
+
+#endif
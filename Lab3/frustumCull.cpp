@@ -0,0 +1,134 @@
+/**
+ * @file frustumCull.cpp
+ * @brief View frustum culling: plane extraction from the view-projection matrix
+ *        and a box against plane test four boxes at a time (SSE, scalar fallback)
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "frustumCull.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_CULL_SSE
+#endif
+
+
+/**
+ * @brief Append a box, growing the padded storage by four boxes at a time
+ *
+ * @param center
+ * @param extent    half size along each axis
+ */
+void boxBatch::add(const glm::vec3& center, const glm::vec3& extent)
+{
+    if (count == cx.size())
+    {
+        size_t padded = count + 4;
+        // Zero size boxes at the origin fill the padding, their result is ignored
+        cx.resize(padded, 0.f); cy.resize(padded, 0.f); cz.resize(padded, 0.f);
+        ex.resize(padded, 0.f); ey.resize(padded, 0.f); ez.resize(padded, 0.f);
+        visible.resize(padded, 0);
+    }
+    cx[count] = center.x; cy[count] = center.y; cz[count] = center.z;
+    ex[count] = extent.x; ey[count] = extent.y; ez[count] = extent.z;
+    count++;
+}
+
+/**
+ * @brief Gribb-Hartmann plane extraction: each plane is the last row of VP plus or minus another row
+ *
+ * @param VP
+ * @return frustumT
+ */
+frustumT extractFrustum(const glm::mat4& VP)
+{
+    // glm is column major: row i is (VP[0][i], VP[1][i], VP[2][i], VP[3][i])
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(VP[0][i], VP[1][i], VP[2][i], VP[3][i]);
+
+    // Left, right, bottom, top, near, far
+    glm::vec4 planes[6] = {row[3] + row[0], row[3] - row[0],
+                           row[3] + row[1], row[3] - row[1],
+                           row[3] + row[2], row[3] - row[2]};
+
+    frustumT frustum;
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = planes[p];
+        frustum.a[p] = plane.x;
+        frustum.b[p] = plane.y;
+        frustum.c[p] = plane.z;
+        frustum.d[p] = plane.w;
+    }
+    return frustum;
+}
+
+/**
+ * @brief A box is outside when, for some plane, even its corner furthest along the
+ *        plane normal is behind it: a*cx + b*cy + c*cz + d + |a|*ex + |b|*ey + |c|*ez < 0.
+ *        The SSE path tests four boxes per plane at once.
+ *
+ * @param frustum
+ * @param boxes
+ * @return size_t
+ */
+size_t cullBoxes(const frustumT& frustum, boxBatch& boxes)
+{
+    size_t visibleCount = 0;
+#ifdef FRUSTUM_CULL_SSE
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < boxes.count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&boxes.cx[i]);
+        __m128 cy = _mm_loadu_ps(&boxes.cy[i]);
+        __m128 cz = _mm_loadu_ps(&boxes.cz[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.ex[i]);
+        __m128 ey = _mm_loadu_ps(&boxes.ey[i]);
+        __m128 ez = _mm_loadu_ps(&boxes.ez[i]);
+
+        // Lanes of boxes found outside a plane
+        __m128 outside = zero;
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 a = _mm_set1_ps(frustum.a[p]);
+            __m128 b = _mm_set1_ps(frustum.b[p]);
+            __m128 c = _mm_set1_ps(frustum.c[p]);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy)),
+                                         _mm_add_ps(_mm_mul_ps(c, cz), _mm_set1_ps(frustum.d[p])));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), ex),
+                                                  _mm_mul_ps(_mm_andnot_ps(signMask, b), ey)),
+                                       _mm_mul_ps(_mm_andnot_ps(signMask, c), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int outsideBits = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < 4 && i + lane < boxes.count; lane++)
+        {
+            bool visible = !(outsideBits & (1 << lane));
+            boxes.visible[i + lane] = visible;
+            visibleCount += visible;
+        }
+    }
+#else
+    for (size_t i = 0; i < boxes.count; i++)
+    {
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; p++)
+        {
+            float distance = frustum.a[p] * boxes.cx[i] + frustum.b[p] * boxes.cy[i] + frustum.c[p] * boxes.cz[i] + frustum.d[p];
+            float radius = fabsf(frustum.a[p]) * boxes.ex[i] + fabsf(frustum.b[p]) * boxes.ey[i] + fabsf(frustum.c[p]) * boxes.ez[i];
+            visible = (distance + radius >= 0.f);
+        }
+        boxes.visible[i] = visible;
+        visibleCount += visible;
+    }
+#endif
+    return visibleCount;
+}
@@ -0,0 +1,49 @@
+/*
+Objective:
+View frustum culling of the pieces' world space bounding boxes
+*/
+
+#ifndef FRUSTUM_CULL_H
+#define FRUSTUM_CULL_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief The six frustum planes (a, b, c, d with a*x + b*y + c*z + d >= 0 inside):
+ *        left, right, bottom, top, near, far
+ *
+ */
+typedef struct
+{
+    float a[6];
+    float b[6];
+    float c[6];
+    float d[6];
+} frustumT;
+
+/**
+ * @brief Axis aligned boxes by component (center and half size), four boxes per SIMD register.
+ *        Storage is padded to a multiple of four.
+ *
+ */
+class boxBatch {
+public:
+    std::vector<float> cx, cy, cz;  // centers
+    std::vector<float> ex, ey, ez;  // half sizes
+    std::vector<unsigned char> visible;  // result of the last cull, one per box
+    size_t count = 0;
+
+    void clear() { count = 0; }
+    void add(const glm::vec3& center, const glm::vec3& extent);
+};
+
+// Planes of the frustum of a view-projection matrix (not normalized, only the sign is used)
+frustumT extractFrustum(const glm::mat4& VP);
+
+// Mark the boxes that are at least partly inside the frustum
+// Returns the number of visible boxes
+size_t cullBoxes(const frustumT& frustum, boxBatch& boxes);
+
+#endif
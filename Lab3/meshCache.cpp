@@ -0,0 +1,302 @@
+/**
+ * @file meshCache.cpp
+ * @brief Binary mesh cache of the OBJ files: written with stdio, read back with mmap
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "meshCache.h"
+#include "assetBundle.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MESH_CACHE_MAGIC[4] = {'C', 'H', 'M', 'C'};
+
+
+/**
+ * @brief Size and modification time of the OBJ file
+ *
+ * @param sourcePath
+ * @param size
+ * @param mtime
+ * @return true if the file exists
+ */
+static bool sourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& mtime)
+{
+    struct stat st;
+    if (stat(sourcePath.c_str(), &st) != 0)
+        return false;
+    size = (uint64_t)st.st_size;
+    mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+/**
+ * @brief MTL file of an OBJ file: same name, .mtl extension (as both models ship it)
+ *
+ * @param sourcePath
+ * @return std::string
+ */
+static std::string materialPath(const std::string& sourcePath)
+{
+    size_t dot = sourcePath.find_last_of('.');
+    size_t slash = sourcePath.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return sourcePath + ".mtl";
+    return sourcePath.substr(0, dot) + ".mtl";
+}
+
+/**
+ * @brief Size and modification time of the MTL file, both 0 when the OBJ file has none
+ *
+ * @param sourcePath
+ * @param size
+ * @param mtime
+ */
+static void materialStamp(const std::string& sourcePath, uint64_t& size, int64_t& mtime)
+{
+    if (!sourceStamp(materialPath(sourcePath), size, mtime))
+    {
+        size = 0;
+        mtime = 0;
+    }
+}
+
+/**
+ * @brief Blobs start on a multiple of 4 bytes (the floats of vertexT)
+ *
+ * @param offset
+ * @return uint64_t
+ */
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + 3) & ~(uint64_t)3;
+}
+
+/**
+ * @brief Cache file of an OBJ file
+ *
+ * @param sourcePath
+ * @return std::string
+ */
+std::string meshCache::cachePath(const std::string& sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+/**
+ * @brief Map the cache and append its components. Every offset and count is
+ *        checked against the file size, and every index against the vertex
+ *        count of its component, before a component is made.
+ *
+ * @param sourcePath
+ * @param components
+ * @return true if the components were appended
+ */
+bool meshCache::load(const std::string& sourcePath, std::vector<chessComponent>& components)
+{
+    release();
+
+    uint64_t sourceSize, materialSize;
+    int64_t sourceMtime, materialMtime;
+    if (!sourceStamp(sourcePath, sourceSize, sourceMtime))
+        return false;
+    materialStamp(sourcePath, materialSize, materialMtime);
+
+    std::string path = cachePath(sourcePath);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(meshCacheHeaderT))
+    {
+        close(fd);
+        return false;
+    }
+    size_t fileSize = (size_t)st.st_size;
+    void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    mapping = data;
+    mappingSize = fileSize;
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    const meshCacheHeaderT* header = (const meshCacheHeaderT*)bytes;
+    if (memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+        header->version != MESH_CACHE_VERSION || header->vertexSize != sizeof(vertexT))
+    {
+        fprintf(stderr, "Mesh cache %s has an old format, rebuilding it\n", path.c_str());
+        release();
+        return false;
+    }
+    if (header->sourceSize != sourceSize || header->sourceMtime != sourceMtime ||
+        header->materialSize != materialSize || header->materialMtime != materialMtime)
+    {
+        fprintf(stderr, "Mesh cache %s is older than its OBJ or MTL file, rebuilding it\n", path.c_str());
+        release();
+        return false;
+    }
+
+    uint64_t recordsEnd = sizeof(meshCacheHeaderT) + (uint64_t)header->componentCount * sizeof(meshCacheRecordT);
+    if (recordsEnd > fileSize)
+    {
+        fprintf(stderr, "Mesh cache %s is truncated\n", path.c_str());
+        release();
+        return false;
+    }
+    const meshCacheRecordT* records = (const meshCacheRecordT*)(bytes + sizeof(meshCacheHeaderT));
+
+    // Check everything before touching the component list
+    for (uint32_t c = 0; c < header->componentCount; c++)
+    {
+        const meshCacheRecordT& record = records[c];
+        uint64_t vertexBytes = (uint64_t)record.vertexCount * sizeof(vertexT);
+        uint64_t indexBytes = (uint64_t)record.indexCount * sizeof(unsigned short);
+        bool valid = memchr(record.name, 0, sizeof(record.name)) != nullptr &&
+                     memchr(record.texture, 0, sizeof(record.texture)) != nullptr &&
+                     record.vertexOffset % 4 == 0 && record.indexOffset % 4 == 0 &&
+                     record.vertexOffset >= recordsEnd && record.indexOffset >= recordsEnd &&
+                     record.vertexOffset <= fileSize && vertexBytes <= fileSize - record.vertexOffset &&
+                     record.indexOffset <= fileSize && indexBytes <= fileSize - record.indexOffset &&
+                     record.indexCount % 3 == 0 &&
+                     indicesInRange((const unsigned short*)(bytes + record.indexOffset), record.indexCount, record.vertexCount);
+        if (!valid)
+        {
+            fprintf(stderr, "Mesh cache %s is damaged (component %u)\n", path.c_str(), c);
+            release();
+            return false;
+        }
+    }
+
+    components.reserve(components.size() + header->componentCount);
+    for (uint32_t c = 0; c < header->componentCount; c++)
+    {
+        const meshCacheRecordT& record = records[c];
+        components.emplace_back();
+        chessComponent& component = components.back();
+        component.storeMeshProps(unpackMeshProps(record.propFlags, record.numOfUVChannels));
+        component.storeComponentID(record.name);
+        if (record.texture[0] != '\0')
+            component.storeTextureID(record.texture);
+        // No copy: the vertices go from the mapping to the GL buffers
+        component.attachPackedMesh((const vertexT*)(bytes + record.vertexOffset), record.vertexCount,
+                                   (const unsigned short*)(bytes + record.indexOffset), record.indexCount);
+    }
+    return true;
+}
+
+/**
+ * @brief Write the cache: header, one record per component, then the vertex and
+ *        index blobs. It goes to a temporary file renamed at the end, so a reader
+ *        never sees half a cache.
+ *
+ * @param sourcePath
+ * @param components
+ * @param first
+ * @return true if the cache was written
+ */
+bool meshCache::write(const std::string& sourcePath, const std::vector<chessComponent>& components, size_t first)
+{
+    meshCacheHeaderT header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(vertexT);
+    header.componentCount = (uint32_t)(components.size() - first);
+    if (!sourceStamp(sourcePath, header.sourceSize, header.sourceMtime))
+        return false;
+    materialStamp(sourcePath, header.materialSize, header.materialMtime);
+
+    // Interleave every component and lay the blobs out after the records
+    std::vector<std::vector<vertexT>> packed(header.componentCount);
+    std::vector<meshCacheRecordT> records(header.componentCount);
+    uint64_t offset = sizeof(meshCacheHeaderT) + (uint64_t)header.componentCount * sizeof(meshCacheRecordT);
+    for (uint32_t c = 0; c < header.componentCount; c++)
+    {
+        const chessComponent& component = components[first + c];
+        meshCacheRecordT& record = records[c];
+        memset(&record, 0, sizeof(record));
+
+        const std::string& name = component.getComponentID();
+        const std::string& texture = component.getTextureFile();
+        if (name.size() >= sizeof(record.name) || texture.size() >= sizeof(record.texture))
+        {
+            fprintf(stderr, "Mesh cache: name of component %s is too long, not cached\n", name.c_str());
+            return false;
+        }
+        memcpy(record.name, name.c_str(), name.size());
+        memcpy(record.texture, texture.c_str(), texture.size());
+
+        record.propFlags = packMeshProps(component.getMeshProps());
+        record.numOfUVChannels = component.getMeshProps().numOfUVChannels;
+
+        component.packVertices(packed[c]);
+        record.vertexCount = (uint32_t)packed[c].size();
+        record.indexCount = (uint32_t)component.getIndices().size();
+        record.vertexOffset = offset;
+        offset = alignOffset(offset + (uint64_t)record.vertexCount * sizeof(vertexT));
+        record.indexOffset = offset;
+        offset = alignOffset(offset + (uint64_t)record.indexCount * sizeof(unsigned short));
+    }
+
+    std::string path = cachePath(sourcePath);
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot write %s\n", tempPath.c_str());
+        return false;
+    }
+
+    static const unsigned char padding[4] = {0, 0, 0, 0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              (records.empty() || fwrite(&records[0], sizeof(meshCacheRecordT), records.size(), file) == records.size());
+    uint64_t written = sizeof(meshCacheHeaderT) + records.size() * sizeof(meshCacheRecordT);
+    for (uint32_t c = 0; c < header.componentCount && ok; c++)
+    {
+        const std::vector<unsigned short>& indices = components[first + c].getIndices();
+        size_t vertexBytes = packed[c].size() * sizeof(vertexT);
+        size_t indexBytes = indices.size() * sizeof(unsigned short);
+        ok = (vertexBytes == 0 || fwrite(&packed[c][0], vertexBytes, 1, file) == 1);
+        written += vertexBytes;
+        ok = ok && fwrite(padding, 1, records[c].indexOffset - written, file) == records[c].indexOffset - written;
+        written = records[c].indexOffset;
+        ok = ok && (indexBytes == 0 || fwrite(&indices[0], indexBytes, 1, file) == 1);
+        written += indexBytes;
+        uint64_t next = alignOffset(written);
+        ok = ok && fwrite(padding, 1, next - written, file) == next - written;
+        written = next;
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        fprintf(stderr, "Failed writing %s\n", path.c_str());
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Unmap the file. Components still pointing into it must have been uploaded.
+ *
+ */
+void meshCache::release()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
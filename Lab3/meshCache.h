@@ -0,0 +1,87 @@
+/*
+Objective:
+Binary mesh cache: the interleaved vertices and the indices of every component
+of an OBJ file, written after the first Assimp import and memory mapped on the
+next launches, so startup skips the OBJ parsing
+*/
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chessComponent.h"
+
+// Bump when the layout below or vertexT changes
+const uint32_t MESH_CACHE_VERSION = 2;
+
+/**
+ * @brief Start of a cache file. The cache is stale when the size or the
+ *        modification time of its OBJ file, or of the MTL file next to it
+ *        (the texture names come from there), changed.
+ *
+ */
+typedef struct
+{
+    char magic[4];              // "CHMC"
+    uint32_t version;           // MESH_CACHE_VERSION
+    uint32_t vertexSize;        // sizeof(vertexT) of the writer
+    uint32_t componentCount;
+    uint64_t sourceSize;        // OBJ file size in bytes
+    int64_t sourceMtime;        // OBJ file modification time (seconds)
+    uint64_t materialSize;      // MTL file size in bytes, 0 if there is none
+    int64_t materialMtime;      // MTL file modification time (seconds), 0 if there is none
+} meshCacheHeaderT;
+
+/**
+ * @brief One component, after the header. Its vertices (vertexT) and indices
+ *        (unsigned short) are packed further in the file, at the offsets given.
+ *
+ */
+typedef struct
+{
+    char name[64];              // node name, null terminated
+    char texture[128];          // diffuse texture as written in the MTL file
+    uint32_t propFlags;         // meshPropsT booleans (MESH_PROP_ bits of assetBundle.h)
+    uint32_t numOfUVChannels;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint64_t vertexOffset;      // from the start of the file
+    uint64_t indexOffset;
+} meshCacheRecordT;
+
+/**
+ * @class meshCache
+ * @brief Read-only mapping of a cache file. The components it fills point into
+ *        the mapping until their setupGLBuffers, so keep the object alive until
+ *        the upload is done (release() then frees the mapping early).
+ *
+ */
+class meshCache {
+private:
+    void* mapping;
+    size_t mappingSize;
+
+public:
+    meshCache() : mapping(nullptr), mappingSize(0) {}
+    ~meshCache() { release(); }
+    meshCache(const meshCache&) = delete;
+    meshCache& operator=(const meshCache&) = delete;
+
+    // Cache file of an OBJ file (next to it)
+    static std::string cachePath(const std::string& sourcePath);
+
+    // Map the cache of sourcePath and append its components
+    // Returns false, with nothing appended, when the cache is missing, stale or damaged
+    bool load(const std::string& sourcePath, std::vector<chessComponent>& components);
+
+    // Write the cache of sourcePath from components[first..end) (just imported, before setupGLBuffers)
+    static bool write(const std::string& sourcePath, const std::vector<chessComponent>& components, size_t first);
+
+    // Unmap the file (after the GL upload)
+    void release();
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+Objective:
+Lock-free single producer / single consumer queue between two threads
+*/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @class spscQueue
+ * @brief Fixed capacity ring of slots. Exactly one thread may push and exactly one
+ *        thread may pop; each side owns one index and only reads the other one,
+ *        so no locks are needed. Capacity must be a power of two (one slot is kept
+ *        free to tell a full ring from an empty one).
+ *
+ */
+template <typename T, size_t Capacity>
+class spscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0 && Capacity >= 2, "Capacity must be a power of two");
+
+private:
+    T slots[Capacity];
+    // Each index on its own cache line so the two threads do not share one
+    alignas(64) std::atomic<size_t> head;   // next slot to pop (written by the consumer)
+    alignas(64) std::atomic<size_t> tail;   // next slot to push (written by the producer)
+
+public:
+    spscQueue() : head(0), tail(0) {}
+
+    /**
+     * @brief Producer side: append an item
+     *
+     * @param item
+     * @return false if the queue is full (the item is not taken)
+     */
+    bool push(T item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) & (Capacity - 1);
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        slots[t] = std::move(item);
+        // Publish the slot contents together with the new tail
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer side: take the oldest item
+     *
+     * @param item
+     * @return false if the queue is empty
+     */
+    bool pop(T& item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = std::move(slots[h]);
+        // Hand the slot back to the producer
+        head.store((h + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+    // Snapshot only, the other thread may change it right after
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+};
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file textureCache.cpp
+ * @brief Reference counted textures shared between the chess components
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "textureCache.h"
+#include <algorithm>
+#include <cstdio>
+
+
+/**
+ * @brief Estimated video memory of a texture
+ *
+ * @param width
+ * @param height
+ * @param levelCount
+ * @return size_t
+ */
+size_t textureCache::textureBytes(unsigned int width, unsigned int height, unsigned int levelCount)
+{
+    size_t total = 0;
+    for (unsigned int level = 0; level < levelCount; level++)
+    {
+        size_t levelWidth = std::max(1u, width >> level);
+        size_t levelHeight = std::max(1u, height >> level);
+        total += levelWidth * levelHeight * 4;
+    }
+    return total;
+}
+
+/**
+ * @brief Levels down to 1x1
+ *
+ * @param width
+ * @param height
+ * @return unsigned int
+ */
+unsigned int textureCache::fullMipLevels(unsigned int width, unsigned int height)
+{
+    unsigned int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
+    return levels;
+}
+
+/**
+ * @brief Take over a texture. A texture already there for the path is kept and the new one deleted.
+ *
+ * @param path
+ * @param texture
+ * @param width
+ * @param height
+ * @param levelCount
+ */
+void textureCache::add(const std::string& path, GLuint texture, unsigned int width, unsigned int height, unsigned int levelCount)
+{
+    if (texture == 0)
+        return;
+    if (entries.count(path) > 0)
+    {
+        glDeleteTextures(1, &texture);
+        return;
+    }
+    textureEntryT entry = {texture, 0, textureBytes(width, height, levelCount)};
+    entries[path] = entry;
+    residentBytes += entry.bytes;
+    peakBytes = std::max(peakBytes, residentBytes);
+}
+
+/**
+ * @brief Texture of a file with one more user
+ *
+ * @param path
+ * @return GLuint, 0 if the file was not added
+ */
+GLuint textureCache::acquire(const std::string& path)
+{
+    auto found = entries.find(path);
+    if (found == entries.end())
+        return 0;
+    textureEntryT& entry = found->second;
+    acquires++;
+    if (entry.references > 0)
+    {
+        shared++;
+        sharedBytes += entry.bytes;
+    }
+    entry.references++;
+    return entry.texture;
+}
+
+/**
+ * @brief One user less
+ *
+ * @param path
+ */
+void textureCache::release(const std::string& path)
+{
+    auto found = entries.find(path);
+    if (found == entries.end())
+        return;
+    textureEntryT& entry = found->second;
+    if (--entry.references > 0)
+        return;
+    glDeleteTextures(1, &entry.texture);
+    residentBytes -= entry.bytes;
+    entries.erase(found);
+}
+
+/**
+ * @brief Delete the textures that were added but never acquired
+ *
+ */
+void textureCache::purgeUnused()
+{
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        if (entry->second.references == 0)
+        {
+            glDeleteTextures(1, &entry->second.texture);
+            residentBytes -= entry->second.bytes;
+            entry = entries.erase(entry);
+        }
+        else
+        {
+            entry++;
+        }
+    }
+}
+
+/**
+ * @brief Print the texture count and memory, and what sharing saved
+ *
+ */
+void textureCache::report() const
+{
+    const double MB = 1024.0 * 1024.0;
+    printf("Textures: %zu files, %.1f MB of video memory (peak %.1f MB), %ld users; "
+           "%ld shared instead of loaded again, %.1f MB saved\n",
+           entries.size(), residentBytes / MB, peakBytes / MB, acquires, shared, sharedBytes / MB);
+}
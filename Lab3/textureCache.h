@@ -0,0 +1,63 @@
+/*
+Objective:
+Textures shared between the chess components: one GL texture per file,
+reference counted, with an estimate of the video memory they take
+*/
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>
+
+/**
+ * @class textureCache
+ * @brief Textures by file path. A texture is added once it is uploaded, with no
+ *        user; acquire() gives it to one more component and release() takes it
+ *        back, the last release deletes it. Needs the GL thread.
+ *
+ */
+class textureCache {
+private:
+    typedef struct
+    {
+        GLuint texture;
+        int references;
+        size_t bytes;       // estimated video memory
+    } textureEntryT;
+
+    std::unordered_map<std::string, textureEntryT> entries;
+    size_t residentBytes;
+    size_t peakBytes;
+    long acquires;
+    long shared;            // acquires served by a texture another component already used
+    size_t sharedBytes;     // memory those would have taken as copies
+
+public:
+    textureCache() : residentBytes(0), peakBytes(0), acquires(0), shared(0), sharedBytes(0) {}
+    textureCache(const textureCache&) = delete;
+    textureCache& operator=(const textureCache&) = delete;
+
+    // Video memory of a texture: 4 bytes per texel (drivers pad RGB8), each mip level a quarter of the last
+    static size_t textureBytes(unsigned int width, unsigned int height, unsigned int levelCount);
+    // Levels of a full mip chain (glGenerateMipmap)
+    static unsigned int fullMipLevels(unsigned int width, unsigned int height);
+
+    // Take over a texture uploaded for a file (not used by anyone yet)
+    void add(const std::string& path, GLuint texture, unsigned int width, unsigned int height, unsigned int levelCount);
+    // Texture of a file with one more user; 0 when it was not added
+    GLuint acquire(const std::string& path);
+    // One user less, the texture is deleted with the last one
+    void release(const std::string& path);
+    // Delete the textures nobody acquired
+    void purgeUnused();
+
+    size_t count() const { return entries.size(); }
+    size_t bytes() const { return residentBytes; }
+    // Texture count, memory, and what sharing saved
+    void report() const;
+};
+
+#endif
@@ -0,0 +1,394 @@
+/**
+ * @file chess_asset_bake.cpp
+ * @brief Offline asset baker: imports the OBJ files of the scene with Assimp,
+ *        reads the BMP textures they use, builds their mip chains and writes
+ *        everything into one bundle the game maps at startup (see assetBundle.h).
+ *
+ *        Usage: chess_asset_bake [options]
+ *          --root <dir>     directory the game runs from (default: .)
+ *          --out <file>     bundle to write (default: assets.bundle)
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <assimp/Importer.hpp>      // C++ importer interface
+#include <assimp/scene.h>           // Output data structure
+#include <assimp/postprocess.h>     // Post processing flags
+#include <common/bmpfile.hpp>
+#include "Lab3/assetBundle.h"
+
+typedef struct
+{
+    bundleMeshT record;
+    std::vector<vertexT> vertices;
+    std::vector<unsigned short> indices;
+} bakedMeshT;
+
+typedef struct
+{
+    bundleTextureT record;
+    std::vector<std::vector<unsigned char>> levels;
+} bakedTextureT;
+
+
+/**
+ * @brief Copy a string into a fixed size record field
+ *
+ * @param field
+ * @param size
+ * @param value
+ * @return false if it does not fit
+ */
+static bool copyField(char* field, size_t size, const std::string& value)
+{
+    if (value.size() >= size)
+    {
+        fprintf(stderr, "Name too long for the bundle: %s\n", value.c_str());
+        return false;
+    }
+    memcpy(field, value.c_str(), value.size() + 1);
+    return true;
+}
+
+/**
+ * @brief Import an OBJ file the way loadAssImpLab3 does (first mesh of each child
+ *        of the root node) and interleave it, with its bounds and geometric center
+ *
+ * @param root
+ * @param source    path as opened by the game
+ * @param meshes
+ * @return true if imported
+ */
+static bool bakeOBJ(const std::string& root, const char* source, std::vector<bakedMeshT>& meshes)
+{
+    std::string file = root + "/" + source;
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(file, (aiProcess_Triangulate |
+                                                    aiProcess_JoinIdenticalVertices |
+                                                    aiProcess_SortByPType));
+    if (!scene)
+    {
+        fprintf(stderr, "%s: %s\n", file.c_str(), importer.GetErrorString());
+        return false;
+    }
+
+    size_t first = meshes.size();
+    const aiNode* rNode = scene->mRootNode;
+    for (unsigned int i = 0; i < rNode->mNumChildren; i++)
+    {
+        const aiNode* cNode = rNode->mChildren[i];
+        if (cNode->mNumMeshes == 0)
+            continue;
+        const aiMesh* mesh = scene->mMeshes[cNode->mMeshes[0]];
+        if (mesh->mNumVertices > 65536)
+        {
+            fprintf(stderr, "%s: mesh %s has %u vertices, more than 16-bit indices can address\n",
+                    file.c_str(), cNode->mName.C_Str(), mesh->mNumVertices);
+            return false;
+        }
+
+        bakedMeshT baked;
+        memset(&baked.record, 0, sizeof(baked.record));
+        bundleMeshT& record = baked.record;
+        if (!copyField(record.source, sizeof(record.source), source) ||
+            !copyField(record.name, sizeof(record.name), cNode->mName.C_Str()))
+            return false;
+
+        meshPropsT meshProps = {mesh->HasBones(), mesh->HasFaces(), mesh->HasNormals(),
+                                mesh->HasPositions(), mesh->HasTangentsAndBitangents(),
+                                mesh->HasTextureCoords(0), mesh->HasVertexColors(0),
+                                mesh->GetNumUVChannels()};
+        record.propFlags = packMeshProps(meshProps);
+        record.numOfUVChannels = meshProps.numOfUVChannels;
+
+        aiString texturePath;
+        const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS &&
+            !copyField(record.texture, sizeof(record.texture), texturePath.C_Str()))
+            return false;
+
+        baked.vertices.resize(mesh->mNumVertices);
+        glm::vec3 center(0.f);
+        glm::vec3 boundsMin(0.f), boundsMax(0.f);
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+        {
+            vertexT& vertex = baked.vertices[v];
+            const aiVector3D& pos = mesh->mVertices[v];
+            vertex.position = glm::vec3(pos.x, pos.y, pos.z);
+            vertex.uv = mesh->HasTextureCoords(0) ? glm::vec2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y) : glm::vec2(0.f);
+            vertex.normal = mesh->HasNormals() ? glm::vec3(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z) : glm::vec3(0.f);
+
+            center += vertex.position;
+            boundsMin = (v == 0) ? vertex.position : glm::min(boundsMin, vertex.position);
+            boundsMax = (v == 0) ? vertex.position : glm::max(boundsMax, vertex.position);
+        }
+        if (mesh->mNumVertices > 0)
+            center /= (float)mesh->mNumVertices;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            record.center[axis] = center[axis];
+            record.boundsMin[axis] = boundsMin[axis];
+            record.boundsMax[axis] = boundsMax[axis];
+        }
+
+        baked.indices.reserve(3 * mesh->mNumFaces);
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            const aiFace& face = mesh->mFaces[f];
+            if (face.mNumIndices != 3)
+                continue;   // points and lines left by the triangulation
+            for (unsigned int k = 0; k < 3; k++)
+                baked.indices.push_back((unsigned short)face.mIndices[k]);
+        }
+        record.vertexCount = (uint32_t)baked.vertices.size();
+        record.indexCount = (uint32_t)baked.indices.size();
+        meshes.push_back(baked);
+    }
+    printf("%s: %zu meshes\n", source, meshes.size() - first);
+    return true;
+}
+
+/**
+ * @brief Read an uncompressed 24-bit BMP into bottom up BGR rows without padding
+ *        (mapped and checked by mapBMP, as the game does)
+ *
+ * @param file
+ * @param width
+ * @param height
+ * @param texels
+ * @return true if read
+ */
+static bool readBMP(const std::string& file, uint32_t& width, uint32_t& height, std::vector<unsigned char>& texels)
+{
+    bmpMappingT bmp;
+    if (!mapBMP(file.c_str(), bmp))
+        return false;
+
+    width = bmp.width;
+    height = bmp.height;
+    size_t rowBytes = (size_t)width * 3;
+    texels.resize(rowBytes * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        // Top down files store the last row of the texture first
+        uint32_t target = bmp.topDown ? height - 1 - y : y;
+        memcpy(&texels[target * rowBytes], bmp.pixels + (size_t)y * bmp.rowStride, rowBytes);
+    }
+    unmapBMP(bmp);
+    return true;
+}
+
+/**
+ * @brief Mip chain down to 1x1, each level a 2x2 box filter of the one above
+ *        (the last row or column is repeated for odd sizes)
+ *
+ * @param texture   level 0 in levels[0]
+ */
+static void buildMipmaps(bakedTextureT& texture)
+{
+    bundleTextureT& record = texture.record;
+    uint32_t level = 0;
+    while ((mipSize(record.width, level) > 1 || mipSize(record.height, level) > 1) && level + 1 < (uint32_t)BUNDLE_MAX_LEVELS)
+    {
+        uint32_t srcWidth = mipSize(record.width, level), srcHeight = mipSize(record.height, level);
+        uint32_t dstWidth = mipSize(record.width, level + 1), dstHeight = mipSize(record.height, level + 1);
+        const std::vector<unsigned char>& src = texture.levels[level];
+        std::vector<unsigned char> dst((size_t)dstWidth * dstHeight * 3);
+        for (uint32_t y = 0; y < dstHeight; y++)
+        {
+            uint32_t y0 = std::min(2 * y, srcHeight - 1), y1 = std::min(2 * y + 1, srcHeight - 1);
+            for (uint32_t x = 0; x < dstWidth; x++)
+            {
+                uint32_t x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int sum = src[((size_t)y0 * srcWidth + x0) * 3 + c] + src[((size_t)y0 * srcWidth + x1) * 3 + c] +
+                                       src[((size_t)y1 * srcWidth + x0) * 3 + c] + src[((size_t)y1 * srcWidth + x1) * 3 + c];
+                    dst[((size_t)y * dstWidth + x) * 3 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        texture.levels.push_back(dst);
+        level++;
+    }
+    record.levelCount = (uint32_t)texture.levels.size();
+}
+
+/**
+ * @brief Blobs start on a multiple of 4 bytes
+ *
+ * @param offset
+ * @return uint64_t
+ */
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + 3) & ~(uint64_t)3;
+}
+
+/**
+ * @brief Append bytes and pad to the next multiple of 4
+ *
+ * @param file
+ * @param data
+ * @param size
+ * @return true if written
+ */
+static bool writeBlob(FILE* file, const void* data, size_t size)
+{
+    static const unsigned char padding[4] = {0, 0, 0, 0};
+    size_t pad = alignOffset(size) - size;
+    return (size == 0 || fwrite(data, 1, size, file) == size) && fwrite(padding, 1, pad, file) == pad;
+}
+
+/**
+ * @brief Lay out and write the bundle (through a temporary file renamed at the end)
+ *
+ * @param path
+ * @param meshes
+ * @param textures
+ * @return true if written
+ */
+static bool writeBundle(const std::string& path, std::vector<bakedMeshT>& meshes, std::vector<bakedTextureT>& textures)
+{
+    bundleHeaderT header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_BUNDLE_MAGIC, sizeof(ASSET_BUNDLE_MAGIC));
+    header.version = ASSET_BUNDLE_VERSION;
+    header.vertexSize = sizeof(vertexT);
+    header.meshCount = (uint32_t)meshes.size();
+    header.textureCount = (uint32_t)textures.size();
+
+    // Offsets, in the order the data is written
+    uint64_t offset = sizeof(bundleHeaderT) + meshes.size() * sizeof(bundleMeshT) + textures.size() * sizeof(bundleTextureT);
+    for (bakedMeshT& mesh : meshes)
+    {
+        mesh.record.vertexOffset = offset;
+        offset = alignOffset(offset + mesh.vertices.size() * sizeof(vertexT));
+        mesh.record.indexOffset = offset;
+        offset = alignOffset(offset + mesh.indices.size() * sizeof(unsigned short));
+    }
+    for (bakedTextureT& texture : textures)
+    {
+        for (size_t level = 0; level < texture.levels.size(); level++)
+        {
+            texture.record.levelOffset[level] = offset;
+            offset = alignOffset(offset + texture.levels[level].size());
+        }
+    }
+
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot write %s\n", tempPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const bakedMeshT& mesh : meshes)
+        ok = ok && fwrite(&mesh.record, sizeof(bundleMeshT), 1, file) == 1;
+    for (const bakedTextureT& texture : textures)
+        ok = ok && fwrite(&texture.record, sizeof(bundleTextureT), 1, file) == 1;
+    for (const bakedMeshT& mesh : meshes)
+    {
+        ok = ok && writeBlob(file, mesh.vertices.data(), mesh.vertices.size() * sizeof(vertexT));
+        ok = ok && writeBlob(file, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned short));
+    }
+    for (const bakedTextureT& texture : textures)
+    {
+        for (const std::vector<unsigned char>& level : texture.levels)
+            ok = ok && writeBlob(file, level.data(), level.size());
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        fprintf(stderr, "Failed writing %s\n", path.c_str());
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Print the usage and quit
+ *
+ */
+static void usage()
+{
+    fprintf(stderr, "Usage: chess_asset_bake [--root <dir>] [--out <file>]\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string root = ".";
+    std::string out = ASSET_BUNDLE_PATH;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--root") && i + 1 < argc)        root = argv[++i];
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc)    out = argv[++i];
+        else usage();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<bakedMeshT> meshes;
+    for (int f = 0; f < NUM_OBJ_FILES; f++)
+    {
+        if (!bakeOBJ(root, objFiles[f], meshes))
+            return 1;
+    }
+
+    // Every texture used by a mesh, once
+    std::vector<bakedTextureT> textures;
+    for (const bakedMeshT& mesh : meshes)
+    {
+        if (mesh.record.texture[0] == '\0')
+            continue;
+        std::string path;
+        if (!textureFilePath(mesh.record.texture, path))
+        {
+            fprintf(stderr, "Texture name %s of %s not understood, not baked\n", mesh.record.texture, mesh.record.name);
+            continue;
+        }
+        bool known = false;
+        for (const bakedTextureT& texture : textures)
+            known = known || (path == texture.record.path);
+        if (known)
+            continue;
+
+        bakedTextureT texture;
+        memset(&texture.record, 0, sizeof(texture.record));
+        texture.levels.resize(1);
+        if (!copyField(texture.record.path, sizeof(texture.record.path), path) ||
+            !readBMP(root + "/" + path, texture.record.width, texture.record.height, texture.levels[0]))
+            return 1;
+        buildMipmaps(texture);
+        printf("%s: %ux%u, %u levels\n", path.c_str(), texture.record.width, texture.record.height, texture.record.levelCount);
+        textures.push_back(texture);
+    }
+
+    if (!writeBundle(out, meshes, textures))
+        return 1;
+
+    // Read it back the way the game does
+    assetBundle check;
+    if (!check.open(out))
+    {
+        fprintf(stderr, "%s does not read back\n", out.c_str());
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Wrote %s: %zu meshes, %zu textures, %.1f MB in %.2f s\n", out.c_str(), check.meshCount(),
+           check.textureCount(), check.size() / (1024.0 * 1024.0), seconds);
+    return 0;
+}
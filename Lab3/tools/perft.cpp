@@ -0,0 +1,263 @@
+/**
+ * @file perft.cpp
+ * @brief Move generator validation and throughput benchmark.
+ *        Counts the leaf nodes of the legal move tree to a fixed depth.
+ *
+ *        Usage: perft <depth> [options]
+ *          --fen "<fen>"    start position (default: standard start position)
+ *          --divide         print the node count below each root move
+ *          --threads <n>    threads splitting the root moves (default: all cores)
+ *          --hash <MB>      transposition table size, 1 to 4096 (default: 0, disabled)
+ *          --expect <n>     exit with an error if the node count differs
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Lab3/chessPosition.h"
+
+// Largest transposition table accepted by --hash
+const long MAX_HASH_MB = 4096;
+
+/**
+ * @brief Shared transposition table for subtree counts
+ *        Lockless: each entry stores key ^ data next to data, a torn write
+ *        from another thread fails the key check and is treated as a miss
+ *
+ */
+class perftHash {
+private:
+    typedef struct
+    {
+        std::atomic<uint64_t> check;    // key ^ data
+        std::atomic<uint64_t> data;     // nodes << 8 | depth
+    } perftEntry;
+
+    std::vector<perftEntry> entries;
+    uint64_t mask;
+
+public:
+    // Size in MB, rounded down to a power of two number of entries
+    explicit perftHash(size_t megaBytes) : entries(0), mask(0)
+    {
+        // Entries that fit, counted per MB so nothing overflows (megaBytes <= MAX_HASH_MB)
+        size_t count = 1;
+        while (count * 2 <= megaBytes * (1024 * 1024 / sizeof(perftEntry)))
+            count *= 2;
+        if (megaBytes > 0)
+        {
+            entries = std::vector<perftEntry>(count);
+            mask = count - 1;
+        }
+    }
+
+    bool enabled() const { return !entries.empty(); }
+
+    bool probe(uint64_t key, int depth, uint64_t& nodes) const
+    {
+        const perftEntry& e = entries[key & mask];
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        if ((e.check.load(std::memory_order_relaxed) ^ data) == key && (int)(data & 0xFF) == depth)
+        {
+            nodes = data >> 8;
+            return true;
+        }
+        return false;
+    }
+
+    void store(uint64_t key, int depth, uint64_t nodes)
+    {
+        perftEntry& e = entries[key & mask];
+        uint64_t data = (nodes << 8) | (uint64_t)depth;
+        e.check.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Count the leaf nodes below a position
+ *
+ * @param position
+ * @param depth
+ * @param hash
+ * @return uint64_t
+ */
+static uint64_t perft(chessPosition& position, int depth, perftHash& hash)
+{
+    moveList legalMoves;
+    generateLegalMoves(position, legalMoves);
+
+    // Bulk count: the last ply does not need to be played
+    if (depth <= 1)
+        return (depth == 1) ? legalMoves.count : 1;
+
+    uint64_t key = 0;
+    uint64_t nodes = 0;
+    if (hash.enabled())
+    {
+        key = position.key;
+        if (hash.probe(key, depth, nodes))
+            return nodes;
+    }
+
+    undoRecord undo;
+    for (chessMove m : legalMoves)
+    {
+        position.makeMove(m, undo);
+        nodes += perft(position, depth - 1, hash);
+        position.unmakeMove(m, undo);
+    }
+
+    if (hash.enabled())
+        hash.store(key, depth, nodes);
+    return nodes;
+}
+
+/**
+ * @brief Print the usage and quit
+ *
+ */
+static void usage()
+{
+    fprintf(stderr, "Usage: perft <depth> [--fen \"<fen>\"] [--divide] [--threads <n>] [--hash <MB>] [--expect <nodes>]\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Size of the --hash option: a positive number of MB, at most MAX_HASH_MB
+ *
+ * @param text
+ * @return size_t
+ */
+static size_t parseHashMB(const char* text)
+{
+    char* end;
+    errno = 0;
+    long megaBytes = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || megaBytes <= 0)
+    {
+        fprintf(stderr, "--hash needs a positive number of MB: %s\n", text);
+        exit(EXIT_FAILURE);
+    }
+    if (megaBytes > MAX_HASH_MB)
+    {
+        fprintf(stderr, "--hash %ld MB is too large, using %ld MB\n", megaBytes, MAX_HASH_MB);
+        megaBytes = MAX_HASH_MB;
+    }
+    return (size_t)megaBytes;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+        usage();
+
+    int depth = atoi(argv[1]);
+    std::string fen = START_FEN;
+    bool divide = false;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t hashMB = 0;
+    long long expect = -1;
+
+    // Parse the options
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--fen") && i + 1 < argc)          fen = argv[++i];
+        else if (!strcmp(argv[i], "--divide"))                  divide = true;
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--hash") && i + 1 < argc)    hashMB = parseHashMB(argv[++i]);
+        else if (!strcmp(argv[i], "--expect") && i + 1 < argc)  expect = atoll(argv[++i]);
+        else usage();
+    }
+    if (depth < 1)
+        usage();
+
+    chessPosition root;
+    if (!root.loadFEN(fen))
+    {
+        fprintf(stderr, "Invalid FEN: %s\n", fen.c_str());
+        return EXIT_FAILURE;
+    }
+
+    perftHash hash(0);
+    try
+    {
+        hash = perftHash(hashMB);
+    }
+    catch (const std::bad_alloc&)
+    {
+        fprintf(stderr, "Can not allocate a %zu MB hash table\n", hashMB);
+        return EXIT_FAILURE;
+    }
+    moveList rootMoves;
+    generateLegalMoves(root, rootMoves);
+    std::vector<uint64_t> rootNodes(rootMoves.count, 0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Threads take the next unsearched root move until none are left
+    std::atomic<int> nextMove(0);
+    auto worker = [&]() {
+        // Each thread plays on its own copy of the root
+        chessPosition position = root;
+        undoRecord undo;
+        for (int i = nextMove++; i < rootMoves.count; i = nextMove++)
+        {
+            position.makeMove(rootMoves.moves[i], undo);
+            rootNodes[i] = perft(position, depth - 1, hash);
+            position.unmakeMove(rootMoves.moves[i], undo);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool)
+        t.join();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    uint64_t total = 0;
+    for (uint64_t n : rootNodes)
+        total += n;
+
+    if (divide)
+    {
+        // Sorted by move, to diff against other engines' divide output
+        std::vector<std::pair<std::string, uint64_t>> lines;
+        for (int i = 0; i < rootMoves.count; i++)
+            lines.push_back({moveToUCI(rootMoves.moves[i]), rootNodes[i]});
+        std::sort(lines.begin(), lines.end());
+        for (auto& line : lines)
+            printf("%s: %llu\n", line.first.c_str(), (unsigned long long)line.second);
+        printf("\n");
+    }
+
+    printf("Depth:   %d\n", depth);
+    printf("Threads: %u\n", threads);
+    printf("Hash:    %zu MB\n", hashMB);
+    printf("Nodes:   %llu\n", (unsigned long long)total);
+    printf("Time:    %.3f s\n", seconds);
+    printf("NPS:     %.0f\n", seconds > 0 ? total / seconds : 0.0);
+
+    if (expect >= 0 && (uint64_t)expect != total)
+    {
+        fprintf(stderr, "Node count mismatch: expected %lld\n", expect);
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
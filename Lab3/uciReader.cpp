@@ -0,0 +1,260 @@
+/**
+ * @file uciReader.cpp
+ * @brief Ring buffer line reader and UCI message tokenizer for the engine pipe
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unistd.h>
+#include "uciReader.h"
+
+
+/**
+ * @brief Construct a new uciLineReader
+ *
+ * @param capacity
+ */
+uciLineReader::uciLineReader(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    ring.resize(size);
+    mask = size - 1;
+    readPos = scanPos = writePos = 0;
+    dropped = 0;
+    skipping = false;
+}
+
+/**
+ * @brief Drop the buffered bytes when the ring is full of a single unfinished line
+ *        (the rest of that line is skipped up to its end of line)
+ *
+ */
+void uciLineReader::makeRoom()
+{
+    if (freeSpace() == 0 && scanPos == writePos)
+    {
+        dropped += writePos - readPos;
+        readPos = scanPos = writePos;
+        skipping = true;
+    }
+}
+
+/**
+ * @brief Read once from a file descriptor into the free space at the end of the ring
+ *
+ * @param fd
+ * @return long bytes read, 0 at end of file, -1 on error (interrupted reads are retried)
+ */
+long uciLineReader::readFrom(int fd)
+{
+    makeRoom();
+    size_t start = writePos & mask;
+    size_t length = std::min(freeSpace(), ring.size() - start);
+    if (length == 0)
+        return 0;
+
+    // A signal delivered to this thread interrupts the read, it is not the end of the pipe
+    ssize_t bytesRead;
+    do
+    {
+        bytesRead = read(fd, &ring[start], length);
+    } while (bytesRead < 0 && errno == EINTR);
+    if (bytesRead > 0)
+        writePos += bytesRead;
+    return bytesRead;
+}
+
+/**
+ * @brief Copy bytes into the ring
+ *
+ * @param data
+ * @param length
+ * @return size_t how many bytes fit (the rest must be fed again after reading lines)
+ */
+size_t uciLineReader::feed(const char* data, size_t length)
+{
+    size_t copied = 0;
+    makeRoom();
+    while (copied < length && freeSpace() > 0)
+    {
+        size_t start = writePos & mask;
+        size_t chunk = std::min(std::min(freeSpace(), ring.size() - start), length - copied);
+        memcpy(&ring[start], data + copied, chunk);
+        writePos += chunk;
+        copied += chunk;
+    }
+    return copied;
+}
+
+/**
+ * @brief Next complete line, each byte is scanned only once across calls
+ *
+ * @param line      view of the line without the end of line
+ * @return true
+ * @return false if no complete line is buffered
+ */
+bool uciLineReader::nextLine(std::string_view& line)
+{
+    while (scanPos < writePos)
+    {
+        // Search the contiguous part of the unscanned bytes
+        size_t start = scanPos & mask;
+        size_t length = std::min(writePos - scanPos, ring.size() - start);
+        const char* eol = (const char*)memchr(&ring[start], '\n', length);
+        if (!eol)
+        {
+            scanPos += length;
+            continue;
+        }
+
+        size_t end = scanPos + (eol - &ring[start]);
+        size_t first = readPos & mask;
+        size_t count = end - readPos;
+        if (first + count <= ring.size())
+        {
+            line = std::string_view(&ring[first], count);
+        }
+        else
+        {
+            // The line wraps around the end of the ring
+            size_t tail = ring.size() - first;
+            wrapped.assign(&ring[first], tail);
+            wrapped.append(&ring[0], count - tail);
+            line = wrapped;
+        }
+        readPos = scanPos = end + 1;
+
+        if (skipping)
+        {
+            // End of an over-long line
+            dropped += count + 1;
+            skipping = false;
+            continue;
+        }
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief Split off the next space separated token
+ *
+ * @param rest      remaining text, advanced past the token
+ * @return std::string_view (empty at the end)
+ */
+static std::string_view nextToken(std::string_view& rest)
+{
+    size_t start = rest.find_first_not_of(" \t");
+    if (start == std::string_view::npos)
+    {
+        rest = std::string_view();
+        return rest;
+    }
+    rest.remove_prefix(start);
+    size_t end = rest.find_first_of(" \t");
+    std::string_view token = rest.substr(0, end);
+    rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+    return token;
+}
+
+/**
+ * @brief Parse the next token as a number, leaves value unchanged if it is not one
+ *
+ * @param rest
+ * @param value
+ */
+template <typename T>
+static void nextNumber(std::string_view& rest, T& value)
+{
+    std::string_view token = nextToken(rest);
+    std::from_chars(token.data(), token.data() + token.size(), value);
+}
+
+/**
+ * @brief Tokenize one line of engine output
+ *
+ * @param line
+ * @param msg
+ * @return true
+ * @return false for an empty line
+ */
+bool parseUCILine(std::string_view line, uciMessage& msg)
+{
+    std::string_view rest = line;
+    std::string_view command = nextToken(rest);
+    if (command.empty())
+        return false;
+
+    msg.type = UCI_OTHER;
+    msg.bestMove = msg.ponder = std::string_view();
+
+    if (command == "bestmove")
+    {
+        msg.type = UCI_BESTMOVE;
+        msg.bestMove = nextToken(rest);
+        if (nextToken(rest) == "ponder")
+            msg.ponder = nextToken(rest);
+    }
+    else if (command == "readyok")
+    {
+        msg.type = UCI_READYOK;
+    }
+    else if (command == "uciok")
+    {
+        msg.type = UCI_UCIOK;
+    }
+    else if (command == "info")
+    {
+        msg.type = UCI_INFO;
+        uciInfo& info = msg.info;
+        info.depth = info.selDepth = -1;
+        info.multiPV = 1;
+        info.hasScore = info.isMate = false;
+        info.score = 0;
+        info.nodes = info.nps = 0;
+        info.timeMs = 0;
+        info.pv = info.text = std::string_view();
+
+        std::string_view key;
+        while (!(key = nextToken(rest)).empty())
+        {
+            if (key == "depth")             nextNumber(rest, info.depth);
+            else if (key == "seldepth")     nextNumber(rest, info.selDepth);
+            else if (key == "multipv")      nextNumber(rest, info.multiPV);
+            else if (key == "nodes")        nextNumber(rest, info.nodes);
+            else if (key == "nps")          nextNumber(rest, info.nps);
+            else if (key == "time")         nextNumber(rest, info.timeMs);
+            else if (key == "score")
+            {
+                // "score cp <x>" or "score mate <y>", optionally followed by a bound
+                info.hasScore = true;
+                info.isMate = (nextToken(rest) == "mate");
+                nextNumber(rest, info.score);
+            }
+            else if (key == "pv" || key == "string")
+            {
+                // Runs to the end of the line
+                size_t start = rest.find_first_not_of(" \t");
+                std::string_view tail = (start == std::string_view::npos) ? std::string_view() : rest.substr(start);
+                if (key == "pv")
+                    info.pv = tail;
+                else
+                    info.text = tail;
+                break;
+            }
+        }
+    }
+    return true;
+}
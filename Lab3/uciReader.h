@@ -0,0 +1,104 @@
+/*
+Objective:
+Line reader and message tokenizer for the UCI engine pipe
+*/
+
+#ifndef UCI_READER_H
+#define UCI_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class uciLineReader
+ * @brief Fixed size ring buffer between the engine pipe and the line parser.
+ *        Each byte is stored once and scanned for the end of line once; complete
+ *        lines are handed out as views into the ring. Only a line that wraps
+ *        around the end of the ring is copied (into a scratch string).
+ *
+ */
+class uciLineReader {
+private:
+    std::vector<char> ring;     // capacity is a power of two
+    size_t mask;                // capacity - 1
+    size_t readPos;             // stream offset of the first byte not handed out yet
+    size_t scanPos;             // stream offset up to which no end of line was found
+    size_t writePos;            // stream offset of the next byte to store
+    std::string wrapped;        // holds a line split by the end of the ring
+    size_t dropped;             // bytes of over-long lines thrown away
+    bool skipping;              // throwing away the rest of an over-long line
+
+    size_t freeSpace() const { return ring.size() - (writePos - readPos); }
+    // Drop the buffered bytes when the ring is full of a single unfinished line
+    void makeRoom();
+
+public:
+    // Capacity rounded up to a power of two, also the longest line that can be read
+    explicit uciLineReader(size_t capacity = 64 * 1024);
+
+    // Read once from a file descriptor into the ring
+    // Returns the bytes read, 0 at end of file and -1 on error (like read(), but retried on EINTR)
+    long readFrom(int fd);
+    // Copy bytes into the ring, returns how many fit
+    size_t feed(const char* data, size_t length);
+    // Next complete line without its "\n" (and "\r"), false if no complete line is buffered
+    // The view stays valid until the next call to readFrom() or feed()
+    bool nextLine(std::string_view& line);
+
+    // Bytes buffered that are not part of a handed out line yet
+    size_t buffered() const { return writePos - readPos; }
+    // Bytes of lines longer than the capacity that had to be dropped
+    size_t droppedBytes() const { return dropped; }
+};
+
+
+/**
+ * @brief Kind of an engine to GUI message
+ *
+ */
+typedef enum uciMessageType {
+    UCI_INFO,
+    UCI_BESTMOVE,
+    UCI_READYOK,
+    UCI_UCIOK,
+    UCI_OTHER
+} uciMessageType;
+
+/**
+ * @brief Search progress from an "info" line (fields not present keep their defaults)
+ *
+ */
+typedef struct
+{
+    int depth;              // -1 if not given
+    int selDepth;
+    int multiPV;
+    bool hasScore;
+    bool isMate;            // score is moves to mate instead of centipawns
+    int score;
+    uint64_t nodes;
+    uint64_t nps;
+    int timeMs;
+    std::string_view pv;    // moves of the principal variation, space separated
+    std::string_view text;  // free text after "string"
+} uciInfo;
+
+/**
+ * @brief One tokenized engine message, views point into the parsed line
+ *
+ */
+typedef struct
+{
+    uciMessageType type;
+    std::string_view bestMove;  // "bestmove" only
+    std::string_view ponder;    // "bestmove" only, empty if the engine gave none
+    uciInfo info;               // "info" only
+} uciMessage;
+
+// Tokenize one line of engine output, returns false for an empty line
+bool parseUCILine(std::string_view line, uciMessage& msg);
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bmpfile.hpp"
+
+// Little endian header fields, read without unaligned loads
+static unsigned int readU32(const unsigned char * p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+static unsigned int readU16(const unsigned char * p){
+	return p[0] | (p[1] << 8);
+}
+
+bool mapBMP(const char * imagepath, bmpMappingT & bmp){
+
+	bmp.mapping = NULL;
+	bmp.mappingSize = 0;
+	bmp.pixels = NULL;
+
+	int fd = open(imagepath, O_RDONLY);
+	if (fd < 0){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < 54){
+		printf("%s: not a correct BMP file (too short)\n", imagepath);
+		close(fd);
+		return false;
+	}
+	size_t fileSize = (size_t)info.st_size;
+	void * data = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file, the descriptor is not needed any more
+	close(fd);
+	if (data == MAP_FAILED){
+		printf("%s could not be mapped\n", imagepath);
+		return false;
+	}
+	const unsigned char * header = (const unsigned char *)data;
+
+	// BITMAPFILEHEADER (14 bytes) then a BITMAPINFOHEADER (40 bytes) or a later version of it
+	const char * problem = NULL;
+	unsigned int dataPos = readU32(header + 0x0A);
+	unsigned int infoSize = readU32(header + 0x0E);
+	int width = (int)readU32(header + 0x12);
+	int height = (int)readU32(header + 0x16);
+	// Some BMP files are misformatted: the pixels right after the headers
+	if (dataPos == 0)
+		dataPos = 14 + infoSize;
+	if (header[0] != 'B' || header[1] != 'M')             problem = "no BM signature";
+	else if (infoSize < 40 || 14 + (size_t)infoSize > fileSize) problem = "unknown info header";
+	else if (readU16(header + 0x1A) != 1)                  problem = "planes is not 1";
+	else if (readU16(header + 0x1C) != 24)                 problem = "not 24 bits per pixel";
+	else if (readU32(header + 0x1E) != 0)                  problem = "compressed";
+	else if (width <= 0 || height == 0 || width > (int)BMP_MAX_SIZE ||
+	         height > (int)BMP_MAX_SIZE || height < -(int)BMP_MAX_SIZE) problem = "bad size";
+	else if (dataPos < 14 + infoSize || dataPos >= fileSize) problem = "pixel data outside the file";
+
+	if (problem == NULL){
+		bmp.width = (unsigned int)width;
+		bmp.topDown = height < 0;
+		bmp.height = (unsigned int)(height < 0 ? -height : height);
+		// 3 : one byte for each Red, Green and Blue component, rows padded to 4 bytes
+		unsigned long long stride = ((unsigned long long)bmp.width * 3 + 3) & ~3ull;
+		// imageSize (0x22) is often 0 or wrong: the rows must fit in the file whatever it says
+		if (stride * bmp.height > fileSize - dataPos)
+			problem = "pixel data outside the file";
+		bmp.rowStride = (unsigned int)stride;
+	}
+	if (problem != NULL){
+		printf("%s: not a correct BMP file (%s)\n", imagepath, problem);
+		munmap(data, fileSize);
+		return false;
+	}
+
+	bmp.pixels = header + dataPos;
+	bmp.mapping = data;
+	bmp.mappingSize = fileSize;
+	// Read ahead now, so the upload does not wait on page faults
+	madvise(data, fileSize, MADV_WILLNEED);
+	return true;
+}
+
+void unmapBMP(bmpMappingT & bmp){
+	if (bmp.mapping != NULL)
+		munmap(bmp.mapping, bmp.mappingSize);
+	bmp.mapping = NULL;
+	bmp.mappingSize = 0;
+	bmp.pixels = NULL;
+}
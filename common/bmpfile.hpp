@@ -0,0 +1,25 @@
+#ifndef BMPFILE_HPP
+#define BMPFILE_HPP
+
+#include <cstddef>
+
+// Largest width or height accepted (keeps the row and image sizes far from overflowing)
+const unsigned int BMP_MAX_SIZE = 32768;
+
+// A .BMP file mapped in memory, its header checked against the file size.
+// The pixels are used in place (no copy), until unmapBMP
+typedef struct {
+	unsigned int width;
+	unsigned int height;
+	unsigned int rowStride;         // bytes from one row to the next, padded to 4
+	bool topDown;                   // negative height in the header: the top row comes first
+	const unsigned char * pixels;   // first row of the file
+	void * mapping;
+	size_t mappingSize;
+} bmpMappingT;
+
+// Map and validate an uncompressed 24-bit .BMP file (any thread, no OpenGL)
+bool mapBMP(const char * imagepath, bmpMappingT & bmp);
+void unmapBMP(bmpMappingT & bmp);
+
+#endif
@@ -1,30 +1,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <vector>
 
 #include <GL/glew.h>
 
 #include <GLFW/glfw3.h>
 
 
+#include "texture.hpp"
+
 GLuint loadBMP_custom(const char * imagepath){
 
+	// Read the file, then hand the pixels to OpenGL
+	bmpImageT image;
+	if (!readBMP_custom(imagepath, image))
+		return 0;
+	return uploadBMP_custom(image);
+}
+
+bool readBMP_custom(const char * imagepath, bmpImageT & image){
+
 	printf("Reading image %s\n", imagepath);
 
 	// Data read from the header of the BMP file
 	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int imageSize;
+	uint32_t dataPos;
+	size_t imageSize;
 	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
 
 	// Open the file
 	FILE * file = fopen(imagepath,"rb");
 	if (!file){
 		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
-		getchar();
-		return 0;
+		return false;
 	}
 
 	// Read the header, i.e. the 54 first bytes
@@ -33,36 +43,60 @@ GLuint loadBMP_custom(const char * imagepath){
 	if ( fread(header, 1, 54, file)!=54 ){ 
 		printf("Not a correct BMP file\n");
 		fclose(file);
-		return 0;
+		return false;
 	}
 	// A BMP files always begins with "BM"
 	if ( header[0]!='B' || header[1]!='M' ){
 		printf("Not a correct BMP file\n");
 		fclose(file);
-		return 0;
+		return false;
 	}
-	// Make sure this is a 24bpp file
-	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
-	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
-
-	// Read the information about the image
-	dataPos    = *(int*)&(header[0x0A]);
-	imageSize  = *(int*)&(header[0x22]);
-	width      = *(int*)&(header[0x12]);
-	height     = *(int*)&(header[0x16]);
+	// Read the information about the image (memcpy: the fields are not aligned)
+	uint32_t compression;
+	uint16_t bitsPerPixel;
+	int32_t signedWidth, signedHeight;
+	memcpy(&dataPos,      &header[0x0A], 4);
+	memcpy(&signedWidth,  &header[0x12], 4);
+	memcpy(&signedHeight, &header[0x16], 4);
+	memcpy(&bitsPerPixel, &header[0x1C], 2);
+	memcpy(&compression,  &header[0x1E], 4);
+
+	// Make sure this is a 24bpp file, bottom up, of a size the buffer can hold
+	// (top down rows are only read by mapBMP)
+	if ( compression!=0 || bitsPerPixel!=24 ) {printf("Not a correct BMP file\n");    fclose(file); return false;}
+	if ( signedWidth<=0 || signedHeight<=0 || signedWidth>(int32_t)BMP_MAX_SIZE || signedHeight>(int32_t)BMP_MAX_SIZE ){
+		printf("%s: unsupported BMP size %d x %d\n", imagepath, signedWidth, signedHeight);
+		fclose(file);
+		return false;
+	}
+	width  = (unsigned int)signedWidth;
+	height = (unsigned int)signedHeight;
 
 	// Some BMP files are misformatted, guess missing information
-	if (imageSize==0)    imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
+	// 3 : one byte for each Red, Green and Blue component, rows padded to 4 bytes (as OpenGL unpacks them)
+	// The image size is computed, the one in the header (0x22) is often 0 or wrong
+	size_t rowSize = ((size_t)width*3 + 3) & ~(size_t)3;
+	imageSize = rowSize*height;
 	if (dataPos==0)      dataPos=54; // The BMP header is done that way
 
-	// Create a buffer
-	data = new unsigned char [imageSize];
-
 	// Read the actual data from the file into the buffer
-	fread(data,1,imageSize,file);
+	image.width = width;
+	image.height = height;
+	image.data.assign(imageSize, 0);
+	// A file cut short is rejected, as mapBMP does, not padded with black
+	if ( fseek(file, dataPos, SEEK_SET)!=0 || fread(&image.data[0],1,imageSize,file)!=imageSize ){
+		printf("%s: not a correct BMP file (truncated)\n", imagepath);
+		image.data.clear();
+		fclose(file);
+		return false;
+	}
 
 	// Everything is in memory now, the file can be closed.
 	fclose (file);
+	return true;
+}
+
+GLuint uploadBMP_custom(const bmpImageT & image){
 
 	// Create one OpenGL texture
 	GLuint textureID;
@@ -72,10 +106,7 @@ GLuint loadBMP_custom(const char * imagepath){
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-	// OpenGL has now copied the data. Free our own version
-	delete [] data;
+	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, image.width, image.height, 0, GL_BGR, GL_UNSIGNED_BYTE, &image.data[0]);
 
 	// Poor filtering, or ...
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -93,6 +124,84 @@ GLuint loadBMP_custom(const char * imagepath){
 	return textureID;
 }
 
+GLuint uploadMappedBMP(const bmpMappingT & bmp){
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// BMP rows are padded to 4 bytes, which is OpenGL's unpack alignment
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (!bmp.topDown){
+		// Bottom row first, as OpenGL expects: the mapped file is the source, no copy on our side
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, bmp.width, bmp.height, 0, GL_BGR, GL_UNSIGNED_BYTE, bmp.pixels);
+	}
+	else{
+		// Top row first: the rows are flipped on their way into a pixel buffer, which the texture is filled from
+		size_t imageSize = (size_t)bmp.rowStride * bmp.height;
+		GLuint pixelBuffer;
+		glGenBuffers(1, &pixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, imageSize, NULL, GL_STREAM_DRAW);
+		unsigned char * rows = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, imageSize,
+		                                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (rows != NULL){
+			for (unsigned int row = 0; row < bmp.height; row++)
+				memcpy(rows + (size_t)row * bmp.rowStride, bmp.pixels + (size_t)(bmp.height - 1 - row) * bmp.rowStride, bmp.rowStride);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, bmp.width, bmp.height, 0, GL_BGR, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pixelBuffer);
+	}
+
+	// Same trilinear filtering as loadBMP_custom
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	return textureID;
+}
+
+GLuint loadBMP_mapped(const char * imagepath){
+
+	bmpMappingT bmp;
+	if (!mapBMP(imagepath, bmp))
+		return 0;
+	GLuint textureID = uploadMappedBMP(bmp);
+	unmapBMP(bmp);
+	return textureID;
+}
+
+GLuint loadBGRMipmaps(unsigned int width, unsigned int height, unsigned int levelCount, const unsigned char * const * levels){
+
+	// Create one OpenGL texture
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// The rows have no padding
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		unsigned int levelWidth = (width >> level) > 0 ? (width >> level) : 1;
+		unsigned int levelHeight = (height >> level) > 0 ? (height >> level) : 1;
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, levelWidth, levelHeight, 0, GL_BGR, GL_UNSIGNED_BYTE, levels[level]);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Same trilinear filtering as loadBMP_custom, the mipmaps are already there
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	return textureID;
+}
+
 // Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 // or do it yourself (just like loadBMP_custom and loadDDS)
 //GLuint loadTGA_glfw(const char * imagepath){
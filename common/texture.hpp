@@ -1,9 +1,34 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
+#include <vector>
+
+#include "bmpfile.hpp"
+
+// BGR pixels of a .BMP file, rows padded to 4 bytes
+typedef struct {
+	unsigned int width;
+	unsigned int height;
+	std::vector<unsigned char> data;
+} bmpImageT;
+
 // Load a .BMP file using our custom loader
+// Legacy: the game loads its textures with mapBMP / uploadMappedBMP, this copying path is
+// kept as the baseline of bench_bmp_load (bottom up files up to BMP_MAX_SIZE only)
 GLuint loadBMP_custom(const char * imagepath);
 
+// The two halves of loadBMP_custom: reading the file (any thread) and creating the texture (GL thread)
+bool readBMP_custom(const char * imagepath, bmpImageT & image);
+GLuint uploadBMP_custom(const bmpImageT & image);
+
+// Create a texture straight from the mapped rows (GL thread)
+GLuint uploadMappedBMP(const bmpMappingT & bmp);
+// mapBMP + uploadMappedBMP + unmapBMP
+GLuint loadBMP_mapped(const char * imagepath);
+
+// Create a texture from BGR mip levels made offline (tightly packed rows, level 0 first)
+GLuint loadBGRMipmaps(unsigned int width, unsigned int height, unsigned int levelCount, const unsigned char * const * levels);
+
 //// Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 //// or do it yourself (just like loadBMP_custom and loadDDS)
 //// Load a .TGA file using GLFW's own loader